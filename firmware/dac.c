@@ -0,0 +1,108 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include "dac.h"
+
+// Commands other than the FINE samples, added by dac_write() and sent
+// one per sample tick by dac_service()
+volatile uint8_t _dac_cmd[DAC_QUEUE_LEN];
+volatile uint16_t _dac_data[DAC_QUEUE_LEN];
+volatile uint8_t _dac_head = 0;
+volatile uint8_t _dac_tail = 0;
+
+// Writes thrown away because the queue was full
+volatile uint8_t dac_overruns = 0;
+
+/**
+ * Set up the SPI peripheral as master to talk to the DAC. A word takes
+ * about 60 cycles at fosc/2, less than an interrupt per byte would, so
+ * it is clocked out by busy waiting from the sample engine.
+ */
+void dac_init(void)
+{
+    // Configure the slave select pin and set it high
+    DAC_DDR |= _BV(DAC_SS) | _BV(DAC_MOSI) | _BV(DAC_SCK);
+    DAC_DDR &= ~(_BV(DAC_MISO));
+    DAC_PORT |= _BV(DAC_SS);
+
+    // Set MSB first, sample on rising edge, 
+    // clock idles low
+    SPCR &= ~(_BV(DORD) | _BV(CPOL) | _BV(CPHA));
+
+    // Enable SPI, set master mode and fosc/2, giving an SPI interface
+    // SCK speed of 8MHz
+    SPSR |= _BV(SPI2X);
+    SPCR &= ~(_BV(SPR0) | _BV(SPR1));
+    SPCR |= _BV(MSTR) | _BV(SPE);
+}
+
+/**
+ * Queue a write and update of one DAC channel. Returns straight away, the
+ * sample engine sends it on its next tick.
+ */
+void dac_write(uint8_t channel, uint16_t value)
+{
+    _dac_push(DAC_LOAD_UPDATE(channel & 0x01), value);
+}
+
+/**
+ * Load both channels and update their outputs together, so the carrier
+ * never sits at a mix of the old and new settings.
+ */
+void dac_write_both(uint16_t a, uint16_t b)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _dac_push(DAC_LOAD(DAC_A), a);
+#if DAC_BITS == 10
+        _dac_push(DAC_LOAD_UPDATE(DAC_B), b);
+#else
+        _dac_push(DAC_LOAD_UPDATE_ALL(DAC_B), b);
+#endif
+    }
+}
+
+/**
+ * Power down the DAC and set the outputs to a high-Z state
+ */
+void dac_off(void)
+{
+    _dac_push(DAC_SLEEP, 0);
+}
+
+/**
+ * Add a command to the queue. If the newest queued command is the same
+ * it is updated in place, so a fast writer never backs up.
+ */
+void _dac_push(uint8_t cmd, uint16_t value)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t last = (_dac_head - 1) & (DAC_QUEUE_LEN - 1);
+        uint8_t next = (_dac_head + 1) & (DAC_QUEUE_LEN - 1);
+
+        if( _dac_head != _dac_tail && _dac_cmd[last] == cmd )
+        {
+            _dac_data[last] = value;
+        }
+        else if( next == _dac_tail )
+        {
+            dac_overruns++;
+        }
+        else
+        {
+            _dac_cmd[_dac_head] = cmd;
+            _dac_data[_dac_head] = value;
+            _dac_head = next;
+        }
+    }
+}
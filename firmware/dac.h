@@ -0,0 +1,111 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __DAC_H__
+#define __DAC_H__
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+// DAC_BITS selects the part fitted. 16, 14 and 12 bits are the LTC2602,
+// LTC2612 and LTC2622 which share a 24 bit command word, 10 bits is the
+// LTC1661 with a 16 bit word. Values are always passed left justified in
+// 16 bits so the rest of the code does not care which one it is.
+#ifndef DAC_BITS
+#define DAC_BITS        16
+#endif
+
+#if DAC_BITS != 16 && DAC_BITS != 14 && DAC_BITS != 12 && DAC_BITS != 10
+#error "DAC_BITS must be 16, 14, 12 or 10"
+#endif
+
+#define DAC_MASK        ((uint16_t)(0xFFFF << (16 - DAC_BITS)))
+
+#define DAC_PORT        PORTB
+#define DAC_DDR         DDRB
+#define DAC_MOSI        3
+#define DAC_MISO        4
+#define DAC_SCK         5
+#define DAC_SS          2
+
+#define DAC_A           0
+#define DAC_B           1
+
+// Commands other than FINE samples waiting for the SPI, must be a power
+// of two
+#define DAC_QUEUE_LEN   8
+
+#if DAC_BITS == 10
+#define DAC_WORD_BYTES  2
+#define DAC_LOAD(ch)            (0x1 + (ch))
+#define DAC_LOAD_UPDATE(ch)     (0x9 + (ch))
+#define DAC_SLEEP               0xE
+#else
+#define DAC_WORD_BYTES  3
+#define DAC_LOAD(ch)            (0x00 | (ch))
+#define DAC_LOAD_UPDATE_ALL(ch) (0x20 | (ch))
+#define DAC_LOAD_UPDATE(ch)     (0x30 | (ch))
+#define DAC_SLEEP               0x4F
+#endif
+
+// Clock one byte out and wait for it to go, 16 cycles at fosc/2
+#define _DAC_SPI(b)     do { SPDR = (b); \
+                            while( !(SPSR & _BV(SPIF)) ); } while(0)
+
+/**
+ * Send one command word straight away, waiting on the SPI. Inline so
+ * the sample engine can write FINE without a call.
+ */
+static inline void dac_send(uint8_t cmd, uint16_t value)
+{
+    value &= DAC_MASK;
+    DAC_PORT &= ~(_BV(DAC_SS));
+#if DAC_BITS == 10
+    // 4 bit control code, 10 data bits, 2 don't care
+    uint16_t w = (uint16_t)cmd << 12 | (value >> 6) << 2;
+    _DAC_SPI(w >> 8);
+    _DAC_SPI(w & 0xFF);
+#else
+    _DAC_SPI(cmd);
+    _DAC_SPI(value >> 8);
+    _DAC_SPI(value & 0xFF);
+#endif
+    DAC_PORT |= _BV(DAC_SS);
+}
+
+extern volatile uint8_t _dac_cmd[DAC_QUEUE_LEN];
+extern volatile uint16_t _dac_data[DAC_QUEUE_LEN];
+extern volatile uint8_t _dac_head;
+extern volatile uint8_t _dac_tail;
+extern volatile uint8_t dac_overruns;
+
+/**
+ * Send the oldest queued command, if there is one. Only the sample
+ * engine calls this, so it owns the SPI. Returns true if it sent
+ * something and the SPI has been used for this tick. Inline like
+ * dac_send(), a call from the sample engine would make it save every
+ * call clobbered register on every tick.
+ */
+static inline bool dac_service(void)
+{
+    uint8_t tail = _dac_tail;
+
+    if( tail == _dac_head ) return false;
+
+    dac_send(_dac_cmd[tail], _dac_data[tail]);
+    _dac_tail = (tail + 1) & (DAC_QUEUE_LEN - 1);
+    return true;
+}
+
+void dac_init(void);
+void dac_write(uint8_t channel, uint16_t value);
+void dac_write_both(uint16_t a, uint16_t b);
+void dac_off(void);
+void _dac_push(uint8_t cmd, uint16_t value);
+
+#endif /* __DAC_H__ */
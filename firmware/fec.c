@@ -0,0 +1,80 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "fec.h"
+#include "fec_tables.h"
+
+// Bit n of a byte, MSB first, without a variable shift
+const uint8_t _fec_mask[8] PROGMEM = {
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+};
+
+/**
+ * Gather input bits pi(i) to pi(i + 7) into a byte, MSB first, for the
+ * second coder.
+ */
+uint8_t _fec_interleave(const uint8_t* in, uint16_t i)
+{
+    uint8_t b = 0;
+
+    for(uint8_t n = 0; n < 8; n++)
+    {
+        uint16_t p = pgm_read_word(&fec_interleaver[i + n]);
+        b <<= 1;
+        if( in[p >> 3] & pgm_read_byte(&_fec_mask[p & 7]) )
+            b |= 1;
+    }
+    return b;
+}
+
+/**
+ * Turbo code the FEC_K bits at in, MSB first, into FEC_OUT_BITS bits at
+ * out: systematic, parity 1 and parity 2 for each input bit, then the
+ * tails of both coders. Each byte in goes through both coders a nibble
+ * at a time and comes out as exactly three bytes. Returns the number of
+ * bits written.
+ */
+uint16_t fec_encode(const uint8_t* in, uint8_t* out)
+{
+    uint8_t s1 = 0, s2 = 0;
+
+    for(uint8_t j = 0; j < FEC_IN_BYTES; j++)
+    {
+        uint8_t x = in[j];
+        uint8_t y = _fec_interleave(in, (uint16_t)j * 8);
+        uint16_t w[2];
+
+        for(uint8_t h = 0; h < 2; h++)
+        {
+            uint8_t xn = h ? x & 0x0F : x >> 4;
+            uint8_t yn = h ? y & 0x0F : y >> 4;
+            uint8_t e1 = pgm_read_byte(&fec_rsc[s1 * 16 + xn]);
+            uint8_t e2 = pgm_read_byte(&fec_rsc[s2 * 16 + yn]);
+            s1 = e1 >> 4;
+            s2 = e2 >> 4;
+
+            w[h] = pgm_read_word(&fec_spread[xn]) |
+                pgm_read_word(&fec_spread[e1 & 0x0F]) >> 1 |
+                pgm_read_word(&fec_spread[e2 & 0x0F]) >> 2;
+        }
+
+        *out++ = w[0] >> 4;
+        *out++ = w[0] << 4 | w[1] >> 8;
+        *out++ = w[1];
+    }
+
+    // Six tail bits from each coder finish it off
+    uint16_t tail = (uint16_t)pgm_read_byte(&fec_tail[s1]) << 6 |
+        pgm_read_byte(&fec_tail[s2]);
+    *out++ = tail >> 4;
+    *out = tail << 4;
+
+    return FEC_OUT_BITS;
+}
@@ -0,0 +1,31 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __FEC_H__
+#define __FEC_H__
+
+// FEC_K is the number of bits in a binary frame before coding, set along
+// with the interleaver in the Makefile. It must be a multiple of 8.
+#ifndef FEC_K
+#define FEC_K           376
+#endif
+
+#if FEC_K % 8
+#error "FEC_K must be a multiple of 8"
+#endif
+
+// Rate 1/3 with three tail bits on each of the two coders
+#define FEC_TAIL        3
+#define FEC_IN_BYTES    (FEC_K / 8)
+#define FEC_OUT_BITS    (3 * FEC_K + 4 * FEC_TAIL)
+#define FEC_OUT_BYTES   ((FEC_OUT_BITS + 7) / 8)
+
+uint16_t fec_encode(const uint8_t* in, uint8_t* out);
+uint8_t _fec_interleave(const uint8_t* in, uint16_t i);
+
+#endif /* __FEC_H__ */
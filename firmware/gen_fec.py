@@ -0,0 +1,87 @@
+#!/usr/bin/env python
+# JOEY-M by CU Spaceflight
+#
+# Generate the tables fec.c encodes binary frames with.
+#
+# usage: gen_fec.py <k> <f1> <f2> > fec_tables.h
+#
+# The code is a rate 1/3 turbo code over k bits: two 8 state recursive
+# systematic coders with feedback 13 and parity 15 (octal), the second fed
+# through the interleaver pi(i) = (f1 i + f2 i^2) mod k, each terminated by
+# three tail bits. ground/turbo.c decodes it.
+#
+# fec_rsc runs a coder over four input bits at once, indexed by the state
+# and the nibble, giving the next state in the high nibble and the four
+# parity bits in the low. fec_spread moves the bits of a nibble three
+# places apart so the systematic and both parity streams can be ORed
+# together. fec_tail is the six tail bits that take each state back to
+# zero, and fec_interleaver is pi.
+
+import sys
+
+def step(s, u):
+    """One bit into a coder in state s1 s2 s3, s1 the most recent."""
+    s1, s2, s3 = s >> 2 & 1, s >> 1 & 1, s & 1
+    a = u ^ s2 ^ s3
+    return (a << 2 | s1 << 1 | s2), a ^ s1 ^ s3
+
+def table(out, ctype, name, values, per_line=12):
+    out.write("const %s %s[%d] PROGMEM = {" % (ctype, name, len(values)))
+    for i, v in enumerate(values):
+        out.write("%s0x%02X" % ("\n    " if i % per_line == 0 else " ", v))
+        if i != len(values) - 1:
+            out.write(",")
+    out.write("};\n\n")
+
+def main():
+    if len(sys.argv) != 4:
+        sys.stderr.write("usage: %s <k> <f1> <f2>\n" % sys.argv[0])
+        sys.exit(1)
+
+    k, f1, f2 = [int(a) for a in sys.argv[1:]]
+    pi = [(f1 * i + f2 * i * i) % k for i in range(k)]
+    if k % 8 or k > 2040 or sorted(pi) != list(range(k)):
+        sys.stderr.write("k must be a multiple of 8 up to 2040 and f1, f2 "
+                "must give a permutation\n")
+        sys.exit(1)
+
+    rsc = []
+    for s in range(8):
+        for nibble in range(16):
+            state, parity = s, 0
+            for b in range(3, -1, -1):
+                state, c = step(state, nibble >> b & 1)
+                parity = parity << 1 | c
+            rsc.append(state << 4 | parity)
+
+    spread = []
+    for nibble in range(16):
+        v = 0
+        for b in range(4):
+            if nibble >> b & 1:
+                v |= 1 << (3 * b + 2)
+        spread.append(v)
+
+    tail = []
+    for s in range(8):
+        state, bits = s, 0
+        for i in range(3):
+            u = (state >> 1 ^ state) & 1
+            state, c = step(state, u)
+            bits = bits << 2 | u << 1 | c
+        tail.append(bits)
+
+    out = sys.stdout
+    out.write("/* Generated by gen_fec.py %s, do not edit */\n\n" %
+            " ".join(sys.argv[1:]))
+    out.write("#ifndef __FEC_TABLES_H__\n#define __FEC_TABLES_H__\n\n")
+    out.write("#if FEC_K != %d\n#error \"fec_tables.h is stale, run make\"\n"
+            "#endif\n\n" % k)
+    table(out, "uint8_t", "fec_rsc", rsc)
+    table(out, "uint16_t", "fec_spread", spread, 8)
+    table(out, "uint8_t", "fec_tail", tail)
+    table(out, "uint16_t", "fec_interleaver", pi, 10)
+    out.write("#endif /* __FEC_TABLES_H__ */\n")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+# JOEY-M by CU Spaceflight
+#
+# Generate the FSK transition table used by TIMER2_OVF_vect in radio.c.
+#
+# usage: gen_transition.py <raised-cosine|gaussian> <samples> [bt baud]
+#            > transition.h
+#
+# Each entry is the fraction of the way from the old to the new FINE DAC
+# value, in 1/256ths, for one sample at 62.5kHz. The gaussian shape is the
+# step response of a gaussian filter with the given BT product at the
+# given baud, centred on the table. The table is the same at every baud,
+# so BT only comes out as asked at that one. The table should span about
+# a symbol, anything the filter does outside it is cut off.
+
+import math
+import sys
+
+SAMPLE_RATE = 62500.0
+
+# Each shape takes x from 0 to 1 over the table, and sigma, the width of
+# the gaussian in the same units
+def raised_cosine(x, sigma):
+    return (1.0 - math.cos(math.pi * x)) / 2.0
+
+def gaussian(x, sigma):
+    return 0.5 * (1.0 + math.erf((x - 0.5) / (sigma * math.sqrt(2.0))))
+
+SHAPES = {"raised-cosine": raised_cosine, "gaussian": gaussian}
+
+def main():
+    if len(sys.argv) < 3 or sys.argv[1] not in SHAPES:
+        sys.stderr.write("usage: %s <%s> <samples> [bt baud]\n" %
+                (sys.argv[0], "|".join(sorted(SHAPES))))
+        sys.exit(1)
+
+    shape = SHAPES[sys.argv[1]]
+    n = int(sys.argv[2])
+    bt = float(sys.argv[3]) if len(sys.argv) > 3 else 0.5
+    baud = float(sys.argv[4]) if len(sys.argv) > 4 else 300.0
+    if n < 1 or n > 255:
+        sys.stderr.write("samples must be 1-255\n")
+        sys.exit(1)
+    if bt <= 0 or baud <= 0:
+        sys.stderr.write("bt and baud must be positive\n")
+        sys.exit(1)
+
+    # The filter's sigma is sqrt(ln 2) / (2 pi BT) symbols, scaled to the
+    # length of the table
+    symbol = SAMPLE_RATE / baud
+    sigma = math.sqrt(math.log(2.0)) / (2.0 * math.pi * bt) * symbol / n
+    if shape == gaussian and sigma > 0.25:
+        sys.stderr.write("warning: %d samples cut off the gaussian at BT %g "
+                "and %g baud, it wants about %d\n" %
+                (n, bt, baud, min(255, int(math.ceil(4 * sigma * n)))))
+
+    # Normalise so the curve runs from exactly 0 to exactly 1 over the
+    # table, the ISR writes the target itself once the table runs out
+    lo = shape(0.0, sigma)
+    hi = shape(1.0, sigma)
+    steps = []
+    for i in range(n):
+        y = (shape((i + 1.0) / (n + 1.0), sigma) - lo) / (hi - lo)
+        steps.append(min(255, max(0, int(round(y * 256)))))
+
+    out = sys.stdout
+    out.write("/* Generated by gen_transition.py %s, do not edit */\n\n" %
+            " ".join(sys.argv[1:]))
+    out.write("#ifndef __TRANSITION_H__\n#define __TRANSITION_H__\n\n")
+    out.write("#define DSP_SAMPLES     %d\n\n" % n)
+    out.write("const uint8_t transition_step[DSP_SAMPLES] PROGMEM = {")
+    for i, s in enumerate(steps):
+        out.write("%s%d" % ("\n    " if i % 12 == 0 else " ", s))
+        if i != n - 1:
+            out.write(",")
+    out.write("};\n\n#endif /* __TRANSITION_H__ */\n")
+
+if __name__ == "__main__":
+    main()
@@ -7,12 +7,38 @@
  */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 #include <stdbool.h>
 #include "led.h"
 #include "gps.h"
 #include "radio.h"
 
+// States of the UBX parser
+#define UBX_SYNC1       0
+#define UBX_SYNC2       1
+#define UBX_BODY        2
+
+// Receive ring, filled by USART_RX_vect and drained by gps_update()
+volatile uint8_t _gps_rx_buf[GPS_RX_BUF_LEN];
+volatile uint8_t _gps_rx_head = 0;
+volatile uint8_t _gps_rx_tail = 0;
+
+// Message being assembled: class, id, length, payload then checksum
+uint8_t _gps_state = UBX_SYNC1;
+uint8_t _gps_msg[4 + GPS_UBX_MAX_PAYLOAD + 2];
+uint8_t _gps_msg_ptr = 0;
+uint8_t _gps_msg_len = 0;
+
+// Epoch being assembled, and the last complete one
+gps_fix_t _gps_epoch;
+gps_fix_t gps_fix;
+volatile bool _gps_fresh = false;
+
+// Answer to the last CFG-NAV5 poll
+uint8_t _gps_nav_mode = 0;
+bool _gps_got_nav = false;
+
 /**
  * Set up USART0 for communication with the uBlox GPS
  * at 38400 baud.
@@ -29,143 +55,96 @@ void gps_init(void)
     UBRR0H = 0x00;
     UBRR0L = 0x33;
 
-    // Enable the receiver and transmitter
-    UCSR0B |= _BV(TXEN0) | _BV(RXEN0);
+    // Enable the receiver and transmitter, and interrupt on each
+    // received byte
+    UCSR0B |= _BV(TXEN0) | _BV(RXEN0) | _BV(RXCIE0);
+
+    // Silence the default NMEA sentences (GGA, GLL, GSA, GSV, RMC, VTG)
+    for(uint8_t id = 0x00; id <= 0x05; id++)
+        _gps_set_rate(0xF0, id, 0);
+
+    // Have NAV-SOL, NAV-POSLLH and NAV-TIMEUTC pushed every epoch
+    _gps_set_rate(0x01, 0x06, 1);
+    _gps_set_rate(0x01, 0x02, 1);
+    _gps_set_rate(0x01, 0x21, 1);
+
+    _gps_flush_buffer();
 }
 
 /**
- * Poll the GPS for a position message then extract the useful
- * information from it - POSLLH.
+ * Run everything received since the last call through the UBX parser.
+ * Never blocks, completed messages are published into gps_fix.
  */
-void gps_get_position(int32_t* lat, int32_t* lon, int32_t* alt)
+void gps_update(void)
 {
-    // Request a NAV-POSLLH message from the GPS
-    uint8_t request[8] = {0xB5, 0x62, 0x01, 0x02, 0x00, 0x00, 0x03,
-        0x0A};
-    _gps_send_msg(request, 8);
-    
-    uint8_t buf[36];
-    for(uint8_t i = 0; i < 36; i++)
-        buf[i] = _gps_get_byte();
-
-    // Verify the sync and header bits
-    if( buf[0] != 0xB5 || buf[1] != 0x62 )
-        led_set(LED_RED, 1);
-    if( buf[2] != 0x01 || buf[3] != 0x02 )
-        led_set(LED_RED, 1);
+    while( _gps_rx_tail != _gps_rx_head )
+    {
+        uint8_t b = _gps_rx_buf[_gps_rx_tail];
+        _gps_rx_tail = (_gps_rx_tail + 1) & (GPS_RX_BUF_LEN - 1);
+        _gps_parse_byte(b);
+    }
+}
 
-    // 4 bytes of longitude (1e-7)
-    *lon = (int32_t)buf[10] | (int32_t)buf[11] << 8 | 
-        (int32_t)buf[12] << 16 | (int32_t)buf[13] << 24;
-    
-    // 4 bytes of latitude (1e-7)
-    *lat = (int32_t)buf[14] | (int32_t)buf[15] << 8 | 
-        (int32_t)buf[16] << 16 | (int32_t)buf[17] << 24;
-    
-    // 4 bytes of altitude above MSL (mm)
-    *alt = (int32_t)buf[22] | (int32_t)buf[23] << 8 | 
-        (int32_t)buf[24] << 16 | (int32_t)buf[25] << 24;
+/**
+ * Copy out the most recent complete epoch. Returns true if it has not
+ * been returned before.
+ */
+bool gps_get_fix(gps_fix_t* fix)
+{
+    bool fresh = _gps_fresh;
+    *fix = gps_fix;
+    _gps_fresh = false;
+    return fresh;
+}
 
-    if( !_gps_verify_checksum(&buf[2], 32) ) led_set(LED_RED, 1);
+/**
+ * Return the most recent position from NAV-POSLLH.
+ */
+void gps_get_position(int32_t* lat, int32_t* lon, int32_t* alt)
+{
+    *lat = gps_fix.lat;
+    *lon = gps_fix.lon;
+    *alt = gps_fix.alt;
 }
 
 /**
- * Get the hour, minute and second from the GPS using the NAV-TIMEUTC
- * message.
+ * Return the most recent hour, minute and second from NAV-TIMEUTC.
  */
 void gps_get_time(uint8_t* hour, uint8_t* minute, uint8_t* second)
 {
-    // Send a NAV-TIMEUTC message to the receiver
-    uint8_t request[8] = {0xB5, 0x62, 0x01, 0x21, 0x00, 0x00,
-        0x22, 0x67};
-    _gps_send_msg(request, 8);
-
-    // Get the message back from the GPS
-    uint8_t buf[28];
-    for(uint8_t i = 0; i < 28; i++)
-        buf[i] = _gps_get_byte();
-
-    // Verify the sync and header bits
-    if( buf[0] != 0xB5 || buf[1] != 0x62 )
-        led_set(LED_RED, 1);
-    if( buf[2] != 0x01 || buf[3] != 0x21 )
-        led_set(LED_RED, 1);
-
-    *hour = buf[22];
-    *minute = buf[23];
-    *second = buf[24];
-
-    if( !_gps_verify_checksum(&buf[2], 24) ) led_set(LED_RED, 1);
+    *hour = gps_fix.hour;
+    *minute = gps_fix.minute;
+    *second = gps_fix.second;
 }
 
 /**
- * Check the navigation status to determine the quality of the
- * fix currently held by the receiver with a NAV-STATUS message.
+ * Return the quality of the fix and number of satellites from the
+ * most recent NAV-SOL message.
  */
 void gps_check_lock(uint8_t* lock, uint8_t* sats)
 {
-    // Construct the request to the GPS
-    uint8_t request[8] = {0xB5, 0x62, 0x01, 0x06, 0x00, 0x00,
-        0x07, 0x16};
-    _gps_send_msg(request, 8);
-
-    // Get the message back from the GPS
-    uint8_t buf[60];
-    for(uint8_t i = 0; i < 60; i++)
-        buf[i] = _gps_get_byte();
-
-    // Verify the sync and header bits
-    if( buf[0] != 0xB5 || buf[1] != 0x62 )
-        led_set(LED_RED, 1);
-    if( buf[2] != 0x01 || buf[3] != 0x06 )
-        led_set(LED_RED, 1);
-
-    // Check 60 bytes minus SYNC and CHECKSUM (4 bytes)
-    if( !_gps_verify_checksum(&buf[2], 56) ) led_set(LED_RED, 1);
-
-    // Return the value if GPSfixOK is set in 'flags'
-    if( buf[17] & 0x01 )
-        *lock = buf[16];
-    else
-        *lock = 0;
-
-    *sats = buf[53];
+    *lock = gps_fix.lock;
+    *sats = gps_fix.sats;
 }
 
 /**
  * Verify that the uBlox 6 GPS receiver is set to the <1g airborne
- * navigaion mode.
+ * navigaion mode. Blocks until the receiver answers.
  */
 uint8_t gps_check_nav(void)
 {
     uint8_t request[8] = {0xB5, 0x62, 0x06, 0x24, 0x00, 0x00,
         0x2A, 0x84};
-    _gps_send_msg(request, 8);
-
-    // Get the message back from the GPS
-    uint8_t buf[44];
-    for(uint8_t i = 0; i < 44; i++)
-        buf[i] = _gps_get_byte();
-
-    // Verify sync and header bytes
-    if( buf[0] != 0xB5 || buf[1] != 0x62 )
-        led_set(LED_RED, 1);
-    if( buf[2] != 0x06 || buf[3] != 0x24 )
-        led_set(LED_RED, 1);
 
-    // Check 40 bytes of message checksum
-    if( !_gps_verify_checksum(&buf[2], 40) ) led_set(LED_RED, 1);
-
-    // Clock in and verify the ACK/NACK
-    uint8_t ack[10];
-    for(uint8_t i = 0; i < 10; i++)
-        ack[i] = _gps_get_byte();
+    _gps_got_nav = false;
+    _gps_send_msg(request, 8);
 
-    // If we got a NACK, then return 0xFF
-    if( buf[3] == 0x00 ) return 0xFF;
+    while( !_gps_got_nav )
+        gps_update();
 
-    // Return the navigation mode and let the caller analyse it
-    return buf[8];
+    // Return the navigation mode and let the caller analyse it, 0xFF
+    // means we got a NACK
+    return _gps_nav_mode;
 }
 
 /**
@@ -202,8 +181,6 @@ void gps_ubx_checksum(uint8_t* data, uint8_t len, uint8_t* cka,
  */
 void _gps_send_msg(uint8_t* data, uint8_t len)
 {
-
-    _gps_flush_buffer();
     for(uint8_t i = 0; i < len; i++)
     {
         while( !( UCSR0A & (1<<UDRE0)) );
@@ -214,20 +191,167 @@ void _gps_send_msg(uint8_t* data, uint8_t len)
 }
 
 /**
- * Receive a single byte from the GPS and return it.
+ * Set the rate at which the given message is output on the current port
+ * using a short form CFG-MSG. A rate of 0 disables it.
  */
-uint8_t _gps_get_byte(void)
+void _gps_set_rate(uint8_t cls, uint8_t id, uint8_t rate)
 {
-    // Wait until we have received a byte
-    while( !(UCSR0A & _BV(RXC0)) );
-    return UDR0;
+    uint8_t msg[11] = {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, cls, id, rate,
+        0x00, 0x00};
+    gps_ubx_checksum(&msg[2], 7, &msg[9], &msg[10]);
+    _gps_send_msg(msg, 11);
 }
 
 /**
- * Flush the USART recieve buffer.
+ * Feed a single received byte into the UBX state machine. Messages
+ * with payloads too big for the buffer are dropped and we hunt for
+ * the next sync.
+ */
+void _gps_parse_byte(uint8_t b)
+{
+    switch(_gps_state)
+    {
+        case UBX_SYNC1:
+            if( b == 0xB5 ) _gps_state = UBX_SYNC2;
+            break;
+
+        case UBX_SYNC2:
+            if( b == 0x62 )
+            {
+                _gps_msg_ptr = 0;
+                _gps_state = UBX_BODY;
+            }
+            else if( b != 0xB5 )
+                _gps_state = UBX_SYNC1;
+            break;
+
+        case UBX_BODY:
+            _gps_msg[_gps_msg_ptr++] = b;
+
+            // Length is known once class, id and both length bytes are in
+            if( _gps_msg_ptr == 4 )
+            {
+                if( _gps_msg[3] != 0 || _gps_msg[2] > GPS_UBX_MAX_PAYLOAD )
+                {
+                    _gps_state = UBX_SYNC1;
+                    break;
+                }
+                _gps_msg_len = _gps_msg[2];
+            }
+            else if( _gps_msg_ptr == _gps_msg_len + 6 )
+            {
+                if( _gps_verify_checksum(_gps_msg, _gps_msg_len + 4) )
+                    _gps_handle_msg();
+                else
+                    led_set(LED_RED, 1);
+                _gps_state = UBX_SYNC1;
+            }
+            break;
+    }
+}
+
+/**
+ * Read a little endian 32 bit value out of a UBX payload.
+ */
+static int32_t _gps_le32(uint8_t* p)
+{
+    return (int32_t)p[0] | (int32_t)p[1] << 8 |
+        (int32_t)p[2] << 16 | (int32_t)p[3] << 24;
+}
+
+/**
+ * Fold the interesting fields of a complete, verified message into the
+ * epoch under construction, and publish it once NAV-SOL, NAV-POSLLH and
+ * NAV-TIMEUTC have all arrived with the same iTOW.
+ */
+void _gps_handle_msg(void)
+{
+    uint8_t* payload = &_gps_msg[4];
+    uint16_t id = (uint16_t)_gps_msg[0] << 8 | _gps_msg[1];
+
+    // Every NAV message starts with iTOW, a new one starts a new epoch
+    if( _gps_msg[0] == 0x01 && _gps_msg_len >= 4 )
+    {
+        uint32_t itow = (uint32_t)_gps_le32(payload);
+        if( itow != _gps_epoch.itow )
+        {
+            _gps_epoch.itow = itow;
+            _gps_epoch.updated = 0;
+        }
+    }
+
+    switch(id)
+    {
+        // NAV-SOL, return gpsFix only if GPSfixOK is set in 'flags'
+        case 0x0106:
+            if( payload[11] & 0x01 )
+                _gps_epoch.lock = payload[10];
+            else
+                _gps_epoch.lock = 0;
+            _gps_epoch.sats = payload[47];
+            _gps_epoch.updated |= GPS_GOT_SOL;
+            break;
+
+        // NAV-POSLLH, lat/lon in 1e-7 degrees and height above MSL in mm
+        case 0x0102:
+            _gps_epoch.lon = _gps_le32(&payload[4]);
+            _gps_epoch.lat = _gps_le32(&payload[8]);
+            _gps_epoch.alt = _gps_le32(&payload[16]);
+            _gps_epoch.updated |= GPS_GOT_POSLLH;
+            break;
+
+        // NAV-TIMEUTC
+        case 0x0121:
+            _gps_epoch.hour = payload[16];
+            _gps_epoch.minute = payload[17];
+            _gps_epoch.second = payload[18];
+            _gps_epoch.updated |= GPS_GOT_TIMEUTC;
+            break;
+
+        // CFG-NAV5, dynModel is the third byte
+        case 0x0624:
+            _gps_nav_mode = payload[2];
+            _gps_got_nav = true;
+            break;
+
+        // ACK-NAK, which we only care about if it refused CFG-NAV5
+        case 0x0500:
+            if( payload[0] == 0x06 && payload[1] == 0x24 )
+            {
+                _gps_nav_mode = 0xFF;
+                _gps_got_nav = true;
+            }
+            break;
+    }
+
+    if( _gps_epoch.updated == GPS_GOT_EPOCH )
+    {
+        gps_fix = _gps_epoch;
+        _gps_epoch.updated = 0;
+        _gps_fresh = true;
+    }
+}
+
+/**
+ * Throw away anything in the receive ring that has not been parsed.
  */
 void _gps_flush_buffer(void)
 {
-    uint8_t dummy;
-    while ( UCSR0A & _BV(RXC0) ) dummy = UDR0;
+    _gps_rx_tail = _gps_rx_head;
+    _gps_state = UBX_SYNC1;
+}
+
+/**
+ * Store each byte from the GPS in the receive ring. If the ring is full
+ * the byte is dropped and the parser resyncs on the next message.
+ */
+ISR(USART_RX_vect)
+{
+    uint8_t b = UDR0;
+    uint8_t next = (_gps_rx_head + 1) & (GPS_RX_BUF_LEN - 1);
+    if( next != _gps_rx_tail )
+    {
+        _gps_rx_buf[_gps_rx_head] = b;
+        _gps_rx_head = next;
+    }
 }
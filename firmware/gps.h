@@ -9,7 +9,40 @@
 #ifndef __GPS_H__
 #define __GPS_H__
 
+// Size of the USART receive ring, must be a power of two
+#define GPS_RX_BUF_LEN      128
+
+// Largest UBX payload we keep, NAV-SOL is the biggest we care about
+#define GPS_UBX_MAX_PAYLOAD 52
+
+// Bits in gps_fix_t.updated showing which messages have arrived
+#define GPS_GOT_SOL         0x01
+#define GPS_GOT_POSLLH      0x02
+#define GPS_GOT_TIMEUTC     0x04
+#define GPS_GOT_EPOCH       (GPS_GOT_SOL | GPS_GOT_POSLLH | GPS_GOT_TIMEUTC)
+
+/**
+ * One navigation epoch assembled from the periodic UBX messages
+ */
+typedef struct
+{
+    uint32_t itow;      // GPS time of week in ms, common to all messages
+    int32_t lat;        // 1e-7 degrees
+    int32_t lon;        // 1e-7 degrees
+    int32_t alt;        // mm above MSL
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t lock;       // gpsFix, or 0 if GPSfixOK is not set
+    uint8_t sats;
+    uint8_t updated;    // GPS_GOT_* bits
+} gps_fix_t;
+
+extern gps_fix_t gps_fix;
+
 void gps_init(void);
+void gps_update(void);
+bool gps_get_fix(gps_fix_t* fix);
 void gps_get_position(int32_t* lat, int32_t* lon, int32_t* alt);
 void gps_get_time(uint8_t* hour, uint8_t* min, uint8_t* second);
 void gps_check_lock(uint8_t* lock, uint8_t* sats);
@@ -17,7 +50,9 @@ uint8_t gps_check_nav(void);
 bool _gps_verify_checksum(uint8_t* data, uint8_t len);
 void gps_ubx_checksum(uint8_t* data, uint8_t len, uint8_t* cka, uint8_t* ckb);
 void _gps_send_msg(uint8_t* data, uint8_t len);
-uint8_t _gps_get_byte(void);
+void _gps_set_rate(uint8_t cls, uint8_t id, uint8_t rate);
+void _gps_parse_byte(uint8_t b);
+void _gps_handle_msg(void);
 void _gps_flush_buffer(void);
 
 #endif /*__GPS_H__ */
@@ -0,0 +1,130 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include "history.h"
+
+#define HISTORY_DAY         86400UL
+
+// Longest an entry can pack to, four varints of up to five bytes
+#define HISTORY_ENTRY_MAX   20
+
+static history_fix_t _history[HISTORY_LEN];
+static uint8_t _history_head = 0;
+static uint8_t _history_count = 0;
+
+uint32_t _history_time(telemetry_t* t)
+{
+    return (uint32_t)t->hour * 3600 + (uint32_t)t->minute * 60 + t->second;
+}
+
+/**
+ * Keep the position in t if it is at least HISTORY_INTERVAL seconds
+ * newer than the last one kept. Call on every fix with a lock.
+ */
+void history_add(telemetry_t* t)
+{
+    uint32_t now = _history_time(t);
+
+    if( _history_count )
+    {
+        uint8_t last = (_history_head + HISTORY_LEN - 1) % HISTORY_LEN;
+        uint32_t age = (now + HISTORY_DAY - _history[last].time) % HISTORY_DAY;
+        if( age < HISTORY_INTERVAL ) return;
+    }
+
+    history_fix_t* f = &_history[_history_head];
+    f->time = now;
+    f->lat = t->lat;
+    f->lon = t->lon;
+    f->alt = t->alt / 1000;
+
+    _history_head = (_history_head + 1) % HISTORY_LEN;
+    if( _history_count < HISTORY_LEN ) _history_count++;
+}
+
+/**
+ * Write v seven bits at a time, least significant first, with the top
+ * bit set on all but the last byte.
+ */
+uint8_t* _history_varint(uint8_t* p, uint32_t v)
+{
+    while( v > 0x7F )
+    {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+/**
+ * Zig-zag a delta so small negative numbers stay small varints too.
+ */
+static uint32_t _history_zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/**
+ * Divide by the step rounding to nearest.
+ */
+int32_t _history_steps(int32_t v)
+{
+    if( v >= 0 ) return (v + HISTORY_STEP / 2) / HISTORY_STEP;
+    return -((-v + HISTORY_STEP / 2) / HISTORY_STEP);
+}
+
+/**
+ * Pack the kept fixes older than the anchor, newest first, into at most
+ * len bytes at buf, and return how many were used. Each is four varints:
+ * seconds before the one after it, then the zig-zagged change in
+ * latitude and longitude in HISTORY_STEP units and in altitude in
+ * metres. Deltas are taken from where the receiver will reconstruct the
+ * previous fix, not where it really was, so rounding never builds up.
+ * Fixes stop at the first one that does not fit.
+ */
+uint8_t history_pack(uint8_t* buf, uint8_t len, telemetry_t* anchor)
+{
+    uint32_t time = _history_time(anchor);
+    int32_t lat = anchor->lat, lon = anchor->lon, alt = anchor->alt / 1000;
+    uint8_t* p = buf;
+
+    for(uint8_t i = 1; i <= _history_count; i++)
+    {
+        history_fix_t* f =
+            &_history[(_history_head + HISTORY_LEN - i) % HISTORY_LEN];
+        uint32_t dt = (time + HISTORY_DAY - f->time) % HISTORY_DAY;
+
+        // The anchor itself is usually the newest fix kept
+        if( dt == 0 ) continue;
+
+        int32_t dlat = _history_steps(f->lat - lat);
+        int32_t dlon = _history_steps(f->lon - lon);
+        int32_t dalt = f->alt - alt;
+
+        uint8_t entry[HISTORY_ENTRY_MAX];
+        uint8_t* e = _history_varint(entry, dt);
+        e = _history_varint(e, _history_zigzag(dlat));
+        e = _history_varint(e, _history_zigzag(dlon));
+        e = _history_varint(e, _history_zigzag(dalt));
+
+        uint8_t n = e - entry;
+        if( n > len - (p - buf) ) break;
+        for(uint8_t j = 0; j < n; j++)
+            *p++ = entry[j];
+
+        time = f->time;
+        lat += dlat * HISTORY_STEP;
+        lon += dlon * HISTORY_STEP;
+        alt += dalt;
+    }
+
+    return p - buf;
+}
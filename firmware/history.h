@@ -0,0 +1,43 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include "telemetry.h"
+
+// Fixes kept, and the least time in seconds between two of them. About
+// one binary frame apart, so each frame carries fixes the last did not.
+// Entries only go in when a larger FEC_K leaves room after the rest of
+// the map and the CRC, at 376 there is none. The newest fix kept is
+// usually the frame's own, so two is all that is worth keeping.
+#define HISTORY_LEN         2
+#define HISTORY_INTERVAL    20
+
+// Latitude and longitude deltas are sent in steps of this many 1e-7
+// degrees, about a metre. ground/packet.h has to agree.
+#define HISTORY_STEP        100
+
+/**
+ * One fix in the ring
+ */
+typedef struct
+{
+    uint32_t time;          // seconds into the day
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;            // 1e-7 degrees
+    int32_t alt;            // m above MSL
+} history_fix_t;
+
+void history_add(telemetry_t* t);
+uint8_t history_pack(uint8_t* buf, uint8_t len, telemetry_t* anchor);
+uint8_t* _history_varint(uint8_t* p, uint32_t v);
+uint32_t _history_time(telemetry_t* t);
+int32_t _history_steps(int32_t v);
+
+#endif /* __HISTORY_H__ */
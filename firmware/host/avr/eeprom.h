@@ -0,0 +1,34 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <avr/eeprom.h>. EEMEM variables live in ordinary
+ * memory and the accessors just copy.
+ */
+
+#ifndef __HOST_AVR_EEPROM_H__
+#define __HOST_AVR_EEPROM_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#define EEMEM
+
+static inline uint8_t eeprom_read_byte(const uint8_t* p) { return *p; }
+static inline uint16_t eeprom_read_word(const uint16_t* p) { return *p; }
+static inline uint32_t eeprom_read_dword(const uint32_t* p) { return *p; }
+static inline void eeprom_read_block(void* dst, const void* src, size_t n)
+    { memcpy(dst, src, n); }
+
+static inline void eeprom_update_byte(uint8_t* p, uint8_t v) { *p = v; }
+static inline void eeprom_update_word(uint16_t* p, uint16_t v) { *p = v; }
+static inline void eeprom_update_dword(uint32_t* p, uint32_t v) { *p = v; }
+static inline void eeprom_update_block(const void* src, void* dst, size_t n)
+    { memcpy(dst, src, n); }
+
+#endif /* __HOST_AVR_EEPROM_H__ */
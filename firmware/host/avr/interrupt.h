@@ -0,0 +1,24 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <avr/interrupt.h>. Handlers become ordinary
+ * functions which the harness calls to play the part of the hardware.
+ */
+
+#ifndef __HOST_AVR_INTERRUPT_H__
+#define __HOST_AVR_INTERRUPT_H__
+
+#include <avr/io.h>
+
+#define ISR(vector)     void vector(void); void vector(void)
+
+#define sei()           (SREG |= 0x80)
+#define cli()           (SREG &= ~0x80)
+
+#endif /* __HOST_AVR_INTERRUPT_H__ */
@@ -0,0 +1,140 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <avr/io.h>. Each register the firmware uses is a
+ * plain variable defined in hal.c, with the ATmega328P bit numbers, so
+ * the modules build unchanged for benchmarking on the host.
+ */
+
+#ifndef __HOST_AVR_IO_H__
+#define __HOST_AVR_IO_H__
+
+#include <stdint.h>
+
+#define _BV(bit)        (1 << (bit))
+
+// USART0
+extern volatile uint8_t UDR0;
+extern volatile uint8_t UCSR0A;
+extern volatile uint8_t UCSR0B;
+extern volatile uint8_t UCSR0C;
+extern volatile uint8_t UBRR0H;
+extern volatile uint8_t UBRR0L;
+
+#define RXC0            7
+#define TXC0            6
+#define UDRE0           5
+#define U2X0            1
+#define RXCIE0          7
+#define TXCIE0          6
+#define UDRIE0          5
+#define RXEN0           4
+#define TXEN0           3
+#define UCSZ01          2
+#define UCSZ00          1
+
+// SPI. Reading SPSR is how the firmware waits for a byte to go, so the
+// host build hands the byte in SPDR to host_spi_hook at that point.
+extern volatile uint8_t SPDR;
+extern volatile uint8_t SPCR;
+extern void (*host_spi_hook)(uint8_t byte);
+volatile uint8_t* _host_spsr(void);
+#define SPSR            (*_host_spsr())
+
+#define SPIE            7
+#define SPE             6
+#define DORD            5
+#define MSTR            4
+#define CPOL            3
+#define CPHA            2
+#define SPR1            1
+#define SPR0            0
+#define SPIF            7
+#define SPI2X           0
+
+// TWI
+extern volatile uint8_t TWDR;
+extern volatile uint8_t TWCR;
+extern volatile uint8_t TWSR;
+extern volatile uint8_t TWBR;
+
+#define TWINT           7
+#define TWEA            6
+#define TWSTA           5
+#define TWSTO           4
+#define TWEN            2
+#define TWIE            0
+#define TWPS1           1
+#define TWPS0           0
+
+// TIMER0
+extern volatile uint8_t TCCR0A;
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t TIFR0;
+
+#define WGM01           1
+#define CS02            2
+#define CS01            1
+#define CS00            0
+#define OCIE0A          1
+#define OCF0A           1
+
+// TIMER1
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+
+#define WGM12           3
+#define CS12            2
+#define CS11            1
+#define CS10            0
+#define OCIE1A          1
+#define OCF1A           1
+
+// TIMER2
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t TCNT2;
+extern volatile uint8_t TIMSK2;
+
+#define CS22            2
+#define CS21            1
+#define CS20            0
+#define TOIE2           0
+
+// EEPROM
+extern volatile uint16_t EEAR;
+extern volatile uint8_t EEDR;
+extern volatile uint8_t EECR;
+
+#define EERIE           3
+#define EEMPE           2
+#define EEPE            1
+#define EERE            0
+
+// GPIO
+extern volatile uint8_t PORTB;
+extern volatile uint8_t DDRB;
+extern volatile uint8_t PINB;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t DDRC;
+extern volatile uint8_t PINC;
+extern volatile uint8_t PORTD;
+extern volatile uint8_t DDRD;
+extern volatile uint8_t PIND;
+
+extern volatile uint8_t SREG;
+
+#endif /* __HOST_AVR_IO_H__ */
@@ -0,0 +1,306 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Benchmarks for the hot paths of the firmware, built for the host
+ * against the register file in hal.c. Run with "make bench", or give
+ * the names of the benchmarks to run on the command line.
+ *
+ * Absolute numbers say nothing about the AVR, but a change in ns/op
+ * between two builds on the same machine is worth looking at.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <avr/io.h>
+
+#include "../radio.h"
+#include "../dac.h"
+#include "../gps.h"
+#include "../telemetry.h"
+#include "../fec.h"
+#include "../history.h"
+
+// Run each benchmark for at least this long once calibrated
+#define BENCH_MIN_NS        200000000ULL
+
+typedef struct
+{
+    const char* name;
+    void (*setup)(void);
+    void (*op)(void);
+} bench_t;
+
+// Handlers from the modules, ordinary functions in the host build
+void USART_RX_vect(void);
+void TIMER1_COMPA_vect(void);
+void TIMER2_OVF_vect(void);
+
+
+// Bytes handled by each op, set by the setup function
+static uint16_t bench_bytes;
+
+// Results land here so the compiler cannot throw the work away
+volatile uint32_t bench_sink;
+
+static telemetry_t telem = {
+    .tick = 1234, .hour = 12, .minute = 34, .second = 56,
+    .lat = 522049312, .lon = 1208511, .alt = 32145678,
+    .temperature = -371, .sats = 9, .lock = 3
+};
+static char sentence[128];
+
+// Two NAV epochs with different iTOW, so each one publishes a fix
+static uint8_t ubx[2][128];
+static uint8_t ubx_len;
+static uint8_t ubx_which;
+
+static uint8_t fec_in[FEC_IN_BYTES];
+static uint8_t fec_out[FEC_OUT_BYTES];
+
+/**
+ * Nanoseconds on the monotonic clock.
+ */
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Append a UBX message with the given payload at p, returning the end.
+ */
+static uint8_t* bench_ubx(uint8_t* p, uint8_t cls, uint8_t id,
+        uint8_t* payload, uint8_t len)
+{
+    p[0] = 0xB5;
+    p[1] = 0x62;
+    p[2] = cls;
+    p[3] = id;
+    p[4] = len;
+    p[5] = 0;
+    memcpy(&p[6], payload, len);
+    gps_ubx_checksum(&p[2], len + 4, &p[len + 6], &p[len + 7]);
+    return p + len + 8;
+}
+
+/**
+ * Write v little endian at p.
+ */
+static void bench_le32(uint8_t* p, uint32_t v)
+{
+    for(uint8_t i = 0; i < 4; i++)
+        p[i] = v >> (8 * i);
+}
+
+static void setup_sentence(void)
+{
+    bench_bytes = telemetry_format(sentence, &telem);
+}
+
+static void op_checksum(void)
+{
+    bench_sink += radio_calculate_checksum(sentence);
+}
+
+static void op_ubx_checksum(void)
+{
+    uint8_t a, b;
+    gps_ubx_checksum(ubx[0], ubx_len, &a, &b);
+    bench_sink += a + b;
+}
+
+static void op_format(void)
+{
+    bench_sink += telemetry_format(sentence, &telem);
+}
+
+static void setup_ubx(void)
+{
+    for(uint8_t e = 0; e < 2; e++)
+    {
+        uint8_t sol[52] = {0}, posllh[28] = {0}, timeutc[20] = {0};
+        uint32_t itow = 345600000UL + e * 1000;
+
+        bench_le32(sol, itow);
+        sol[10] = 3;
+        sol[11] = 0x0D;
+        sol[47] = 9;
+
+        bench_le32(posllh, itow);
+        bench_le32(&posllh[4], telem.lon);
+        bench_le32(&posllh[8], telem.lat);
+        bench_le32(&posllh[16], telem.alt);
+
+        bench_le32(timeutc, itow);
+        timeutc[16] = telem.hour;
+        timeutc[17] = telem.minute;
+        timeutc[18] = telem.second;
+
+        uint8_t* p = ubx[e];
+        p = bench_ubx(p, 0x01, 0x06, sol, sizeof(sol));
+        p = bench_ubx(p, 0x01, 0x02, posllh, sizeof(posllh));
+        p = bench_ubx(p, 0x01, 0x21, timeutc, sizeof(timeutc));
+        ubx_len = p - ubx[e];
+    }
+    bench_bytes = ubx_len;
+}
+
+/**
+ * One epoch through the receive ISR, the ring and the parser.
+ */
+static void op_ubx_parse(void)
+{
+    gps_fix_t fix;
+    uint8_t* p = ubx[ubx_which];
+
+    for(uint8_t i = 0; i < ubx_len; i++)
+    {
+        UDR0 = p[i];
+        USART_RX_vect();
+    }
+    gps_update();
+    bench_sink += gps_get_fix(&fix);
+    ubx_which ^= 1;
+}
+
+static void setup_afsk(void)
+{
+    _radio_push_symbol(RADIO_MODE_AFSK, 1);
+}
+
+/**
+ * One tick of the sample engine, including its SPI writes.
+ */
+static void op_sample(void)
+{
+    TIMER2_OVF_vect();
+}
+
+/**
+ * One RTTY sentence through the symbol clock, with the sample engine
+ * only draining the symbol queue.
+ */
+static void op_rtty_frame(void)
+{
+    radio_frame_t* frame = radio_frame_get();
+    frame->type = RADIO_FRAME_RTTY;
+    frame->mode = RADIO_MODE_AFSK;
+    frame->baud = RADIO_BAUD_50;
+    strcpy((char*)frame->data, sentence);
+    radio_frame_submit(frame);
+
+    while( frame->state != RADIO_FRAME_FREE )
+    {
+        TIMER1_COMPA_vect();
+        op_sample();
+    }
+}
+
+static void setup_fec(void)
+{
+    for(uint8_t i = 0; i < sizeof(fec_in); i++)
+        fec_in[i] = i * 37 + 11;
+    bench_bytes = sizeof(fec_in);
+}
+
+static void op_fec_encode(void)
+{
+    bench_sink += fec_encode(fec_in, fec_out);
+}
+
+/**
+ * A full ring of fixes drifting east and climbing.
+ */
+static telemetry_t history_anchor;
+
+static void setup_history(void)
+{
+    telemetry_t t = telem;
+
+    for(uint8_t i = 0; i < HISTORY_LEN; i++)
+    {
+        t.second = i * HISTORY_INTERVAL;
+        t.lat += 1234;
+        t.lon += 4321;
+        t.alt += 25000;
+        history_add(&t);
+    }
+    history_anchor = t;
+
+    // What one op writes, which depends on how many fixes fit
+    bench_bytes = history_pack(fec_in, sizeof(fec_in), &history_anchor);
+}
+
+static void op_history_pack(void)
+{
+    bench_sink += history_pack(fec_in, sizeof(fec_in), &history_anchor);
+}
+
+static const bench_t benches[] = {
+    {"checksum",        setup_sentence, op_checksum},
+    {"ubx_checksum",    setup_ubx,      op_ubx_checksum},
+    {"format",          setup_sentence, op_format},
+    {"ubx_parse",       setup_ubx,      op_ubx_parse},
+    {"sample",          setup_afsk,     op_sample},
+    {"rtty_frame",      setup_sentence, op_rtty_frame},
+    {"fec_encode",      setup_fec,      op_fec_encode},
+    {"history_pack",    setup_history,  op_history_pack},
+};
+
+/**
+ * Double the number of ops until a run takes long enough to time, then
+ * report the time and bytes for a single op.
+ */
+static void bench_run(const bench_t* b)
+{
+    uint64_t n = 1, ns = 0;
+
+    bench_bytes = 0;
+    if( b->setup ) b->setup();
+    b->op();
+
+    while( true )
+    {
+        uint64_t start = bench_now();
+        for(uint64_t i = 0; i < n; i++)
+            b->op();
+        ns = bench_now() - start;
+        if( ns >= BENCH_MIN_NS ) break;
+        n *= 2;
+    }
+
+    printf("%-16s %12llu %12.1f %10u", b->name, (unsigned long long)n,
+            (double)ns / n, bench_bytes);
+    if( bench_bytes )
+        printf(" %10.1f", (double)bench_bytes * 1000.0 * n / ns);
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    radio_init();
+    radio_set_shift(RADIO_SHIFT_425);
+
+    printf("%-16s %12s %12s %10s %10s\n", "benchmark", "ops", "ns/op",
+            "bytes/op", "MB/s");
+
+    for(uint8_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+    {
+        bool run = argc < 2;
+        for(int a = 1; a < argc; a++)
+            if( strcmp(argv[a], benches[i].name) == 0 ) run = true;
+        if( run ) bench_run(&benches[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Register file for the host build. Status flags the firmware busy waits
+ * on start out set, so a transmit or SPI transfer completes as soon as
+ * it is started.
+ */
+
+#include <avr/io.h>
+#include <stddef.h>
+
+volatile uint8_t UDR0;
+volatile uint8_t UCSR0A = _BV(UDRE0) | _BV(TXC0);
+volatile uint8_t UCSR0B;
+volatile uint8_t UCSR0C;
+volatile uint8_t UBRR0H;
+volatile uint8_t UBRR0L;
+
+volatile uint8_t SPDR;
+volatile uint8_t SPCR;
+static volatile uint8_t _spsr = _BV(SPIF);
+void (*host_spi_hook)(uint8_t byte) = NULL;
+
+volatile uint8_t* _host_spsr(void)
+{
+    if( host_spi_hook ) host_spi_hook(SPDR);
+    return &_spsr;
+}
+
+volatile uint8_t TWDR;
+volatile uint8_t TWCR;
+volatile uint8_t TWSR;
+volatile uint8_t TWBR;
+
+volatile uint8_t TCCR0A;
+volatile uint8_t TCCR0B;
+volatile uint8_t TCNT0;
+volatile uint8_t OCR0A;
+volatile uint8_t TIMSK0;
+volatile uint8_t TIFR0;
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t TCNT1;
+volatile uint16_t OCR1A;
+volatile uint8_t TIMSK1;
+volatile uint8_t TIFR1;
+
+volatile uint8_t TCCR2A;
+volatile uint8_t TCCR2B;
+volatile uint8_t TCNT2;
+volatile uint8_t TIMSK2;
+
+volatile uint16_t EEAR;
+volatile uint8_t EEDR;
+volatile uint8_t EECR;
+
+volatile uint8_t PORTB;
+volatile uint8_t DDRB;
+volatile uint8_t PINB;
+volatile uint8_t PORTC;
+volatile uint8_t DDRC;
+volatile uint8_t PINC;
+volatile uint8_t PORTD;
+volatile uint8_t DDRD;
+volatile uint8_t PIND;
+
+volatile uint8_t SREG;
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# JOEY-M by CU Spaceflight
+#
+# Render a DAC trace from host/trace into what the radio would produce.
+#
+# usage: render.py trace.txt [--wav out.wav] [--iq out.cf32] [--rate hz]
+#
+# The WAV is the FINE channel as audio, which is the AFSK tone itself or the
+# FSK levels. The IQ file is complex baseband of the carrier as 32 bit float
+# I/Q pairs, with the frequency offset taken from both channels:
+# RADIO_SHIFT_425 on FINE is 425Hz, and COARSE covers 30kHz about
+# RADIO_CENTER_FREQ_434630. Both default to the DAC sample rate, the TIMER2
+# overflow rate.
+
+import argparse
+import math
+import struct
+import sys
+import wave
+
+F_CPU = 16000000
+SAMPLE_RATE = F_CPU // 256
+
+RADIO_CENTER_FREQ_434630 = 0xA000
+RADIO_SHIFT_425 = 0x0A00
+
+FINE_HZ = 425.0 / RADIO_SHIFT_425
+COARSE_HZ = 30000.0 / 65536
+COARSE = 0
+FINE = 1
+
+
+def read_trace(path):
+    """Yield (cycle, channel, value) from a trace file."""
+    with open(path) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            cycle, ch, value = line.split()
+            yield int(cycle), int(ch), int(value)
+
+
+def samples(path, rate):
+    """
+    Yield (coarse, fine) held at each sample instant from the first
+    event to the last.
+    """
+    cycles_per_sample = F_CPU / rate
+    out = [RADIO_CENTER_FREQ_434630, 0]
+    events = read_trace(path)
+    pending = next(events, None)
+    n = 0
+    while pending is not None:
+        t = n * cycles_per_sample
+        while pending is not None and pending[0] <= t:
+            out[pending[1]] = pending[2]
+            pending = next(events, None)
+        yield out[COARSE], out[FINE]
+        n += 1
+
+
+def write_wav(path, trace, rate):
+    w = wave.open(path, "wb")
+    w.setnchannels(1)
+    w.setsampwidth(2)
+    w.setframerate(rate)
+    buf = bytearray()
+    for coarse, fine in samples(trace, rate):
+        buf += struct.pack("<h", fine - 32768)
+        if len(buf) >= 1 << 16:
+            w.writeframes(bytes(buf))
+            buf = bytearray()
+    w.writeframes(bytes(buf))
+    w.close()
+
+
+def write_iq(path, trace, rate):
+    phase = 0.0
+    with open(path, "wb") as f:
+        buf = bytearray()
+        for coarse, fine in samples(trace, rate):
+            offset = (coarse - RADIO_CENTER_FREQ_434630) * COARSE_HZ + \
+                fine * FINE_HZ
+            phase = math.fmod(phase + 2 * math.pi * offset / rate,
+                    2 * math.pi)
+            buf += struct.pack("<ff", math.cos(phase), math.sin(phase))
+            if len(buf) >= 1 << 16:
+                f.write(buf)
+                buf = bytearray()
+        f.write(buf)
+
+
+def main():
+    p = argparse.ArgumentParser(description="Render a DAC trace")
+    p.add_argument("trace")
+    p.add_argument("--wav", help="FINE channel as audio")
+    p.add_argument("--iq", help="complex baseband as cf32")
+    p.add_argument("--rate", type=int, default=SAMPLE_RATE,
+            help="output sample rate, default %d" % SAMPLE_RATE)
+    args = p.parse_args()
+
+    if next(read_trace(args.trace), None) is None:
+        sys.exit("%s: no DAC writes" % args.trace)
+    if args.wav:
+        write_wav(args.wav, args.trace, args.rate)
+    if args.iq:
+        write_iq(args.iq, args.trace, args.rate)
+
+
+if __name__ == "__main__":
+    main()
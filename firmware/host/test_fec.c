@@ -0,0 +1,159 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Check the firmware turbo encoder against the ground station's, which
+ * is what has to decode it. Run with "make test", exits non-zero on the
+ * first mismatch.
+ *
+ * The interleaver tables are checked against the QPP polynomial
+ * directly, then known blocks and pseudo random ones are encoded by both
+ * fec_encode() and turbo_encode() and compared bit for bit, tails
+ * included.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+
+#include "../fec.h"
+#include "../../ground/turbo.h"
+
+#define TEST_RANDOM         2000
+
+static turbo_t turbo;
+static int failures;
+
+static uint8_t test_bit(const uint8_t* buf, uint16_t i)
+{
+    return buf[i >> 3] >> (7 - (i & 7)) & 1;
+}
+
+/**
+ * Interleaved bit i must be input bit (F1 i + F2 i^2) mod K. Each input
+ * bit in turn is the only one set, and every interleaved byte is read
+ * back to see where it went.
+ */
+static void test_interleaver(void)
+{
+    uint8_t in[FEC_IN_BYTES];
+
+    for(uint16_t p = 0; p < FEC_K; p++)
+    {
+        memset(in, 0, sizeof(in));
+        in[p >> 3] = 0x80 >> (p & 7);
+
+        for(uint16_t i = 0; i < FEC_K; i += 8)
+        {
+            uint8_t b = _fec_interleave(in, i);
+            for(uint8_t n = 0; n < 8; n++)
+            {
+                uint32_t j = i + n;
+                uint16_t want = ((uint32_t)FEC_F1 * j +
+                        (uint32_t)FEC_F2 * j * j) % FEC_K;
+                if( (b >> (7 - n) & 1) != (want == p) )
+                {
+                    printf("interleaver: bit %u from %u, want %u\n", j, p,
+                            want);
+                    exit(1);
+                }
+            }
+        }
+        if( turbo.pi[p] != ((uint32_t)FEC_F1 * p +
+                    (uint32_t)FEC_F2 * p * p) % FEC_K )
+        {
+            printf("interleaver: ground pi[%u] is %u\n", p, turbo.pi[p]);
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Encode in both ways and compare every coded bit.
+ */
+static void test_block(const char* name, const uint8_t* in)
+{
+    uint8_t fw[FEC_OUT_BYTES], ref[FEC_OUT_BYTES];
+
+    memset(fw, 0, sizeof(fw));
+    memset(ref, 0, sizeof(ref));
+    uint16_t bits = fec_encode(in, fw);
+    turbo_encode(&turbo, in, ref);
+
+    if( bits != turbo_coded_bits(&turbo) )
+    {
+        printf("%s: %u coded bits, want %u\n", name, bits,
+                turbo_coded_bits(&turbo));
+        failures++;
+        return;
+    }
+
+    for(uint16_t i = 0; i < bits; i++)
+    {
+        if( test_bit(fw, i) != test_bit(ref, i) )
+        {
+            printf("%s: coded bit %u is %u, want %u%s\n", name, i,
+                    test_bit(fw, i), test_bit(ref, i),
+                    i >= 3 * FEC_K ? " (tail)" : "");
+            failures++;
+            return;
+        }
+    }
+}
+
+int main(void)
+{
+    uint8_t in[FEC_IN_BYTES];
+    char name[32];
+    int blocks = 0;
+
+    if( turbo_init(&turbo, FEC_K, FEC_F1, FEC_F2) != 0 )
+    {
+        printf("turbo_init failed\n");
+        return 1;
+    }
+
+    test_interleaver();
+
+    memset(in, 0x00, sizeof(in));
+    test_block("zeros", in);
+    memset(in, 0xFF, sizeof(in));
+    test_block("ones", in);
+    blocks += 2;
+
+    // One bit at a time, which also leaves each coder in a different
+    // state for its tail
+    for(uint16_t p = 0; p < FEC_K; p++)
+    {
+        memset(in, 0, sizeof(in));
+        in[p >> 3] = 0x80 >> (p & 7);
+        snprintf(name, sizeof(name), "bit %u", p);
+        test_block(name, in);
+        blocks++;
+    }
+
+    uint32_t lfsr = 0xACE1u;
+    for(int n = 0; n < TEST_RANDOM; n++)
+    {
+        for(uint8_t i = 0; i < FEC_IN_BYTES; i++)
+        {
+            lfsr = lfsr * 1103515245u + 12345u;
+            in[i] = lfsr >> 16;
+        }
+        snprintf(name, sizeof(name), "random %d", n);
+        test_block(name, in);
+        blocks++;
+    }
+
+    turbo_free(&turbo);
+    printf("fec: %d blocks of %d bits, %d failed\n", blocks, FEC_K,
+            failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Run the radio module against a simulated clock and log every change
+ * of the DAC outputs, decoded from the bytes sent over SPI. Usage:
+ *
+ *     trace [-r rtty frames] [-b binary frames] [-l levels] > trace.txt
+ *
+ * Binary frames go out as 2FSK, or 4FSK or 8FSK with -l 4 or -l 8.
+ * Each line is the CPU cycle, the channel and the new output value.
+ * render.py turns the result into audio and IQ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <avr/io.h>
+
+#include "../radio.h"
+#include "../dac.h"
+#include "../telemetry.h"
+#include "../fec.h"
+
+// Cycles between TIMER2 overflows, and per count of TIMER1 at /8
+#define TRACE_SAMPLE_CYCLES     256
+#define TRACE_TIMER1_CYCLES     8
+
+// Keep going this long after the last frame so the tail is captured
+#define TRACE_TAIL_CYCLES       (F_CPU / 10)
+
+void TIMER1_COMPA_vect(void);
+void TIMER2_OVF_vect(void);
+extern radio_frame_t radio_frames[2];
+
+static uint64_t now;
+static uint8_t word[DAC_WORD_BYTES];
+static uint8_t word_len;
+static uint16_t input[2];
+static uint16_t output[2];
+static bool output_valid[2];
+static uint8_t binary_mode = RADIO_MODE_FSK;
+
+/**
+ * Log an output if it has changed.
+ */
+static void trace_output(uint8_t ch, uint16_t value)
+{
+    if( output_valid[ch] && output[ch] == value ) return;
+    output[ch] = value;
+    output_valid[ch] = true;
+    printf("%llu %u %u\n", (unsigned long long)now, ch, value);
+}
+
+/**
+ * Decode a complete SPI word the way the DAC would.
+ */
+static void trace_word(void)
+{
+#if DAC_WORD_BYTES == 2
+    uint16_t w = word[0] << 8 | word[1];
+    uint16_t value = ((w >> 2) & 0x3FF) << 6;
+    uint8_t code = w >> 12;
+
+    if( code == 0x1 || code == 0x2 )
+        input[code - 1] = value;
+    else if( code == 0x9 || code == 0xA )
+    {
+        input[code - 0x9] = value;
+        trace_output(code - 0x9, value);
+    }
+#else
+    uint8_t cmd = word[0] >> 4;
+    uint8_t ch = word[0] & 0x01;
+    uint16_t value = word[1] << 8 | word[2];
+
+    if( cmd == 0x0 || cmd == 0x2 || cmd == 0x3 )
+        input[ch] = value;
+    if( cmd == 0x2 )
+    {
+        trace_output(0, input[0]);
+        trace_output(1, input[1]);
+    }
+    else if( cmd == 0x3 )
+        trace_output(ch, value);
+#endif
+}
+
+/**
+ * Play the part of the DAC, taking each byte as the firmware waits for
+ * it to go while slave select is low.
+ */
+static void trace_spi(uint8_t byte)
+{
+    if( DAC_PORT & _BV(DAC_SS) )
+    {
+        word_len = 0;
+        return;
+    }
+
+    word[word_len++] = byte;
+    if( word_len == DAC_WORD_BYTES )
+    {
+        trace_word();
+        word_len = 0;
+    }
+}
+
+/**
+ * Queue a frame like main() does, either the RTTY sentence or the sync
+ * word and a channel coded pseudo random payload standing in for the
+ * telemetry map.
+ */
+static void trace_frame(radio_frame_t* frame, bool binary, uint32_t tick)
+{
+    if( binary )
+    {
+        frame->type = RADIO_FRAME_BINARY;
+        frame->mode = binary_mode;
+        frame->baud = RADIO_BAUD_300;
+        uint8_t payload[FEC_IN_BYTES];
+        uint16_t lfsr = 0xACE1 ^ tick;
+        for(uint8_t i = 0; i < FEC_IN_BYTES; i++)
+        {
+            lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+            payload[i] = lfsr;
+        }
+
+        for(uint8_t i = 0; i < RADIO_SYNC_BYTES; i++)
+            frame->data[i] = RADIO_BINARY_SYNC >>
+                (8 * (RADIO_SYNC_BYTES - 1 - i));
+        frame->bits = RADIO_SYNC_BYTES * 8 +
+            fec_encode(payload, &frame->data[RADIO_SYNC_BYTES]);
+    }
+    else
+    {
+        telemetry_t telem = {
+            .tick = tick, .hour = 12, .minute = 34, .second = 56,
+            .lat = 522049312, .lon = 1208511, .alt = 32145678,
+            .temperature = -371, .sats = 9, .lock = 3
+        };
+        char* s = (char*)frame->data;
+
+        frame->type = RADIO_FRAME_RTTY;
+        frame->mode = RADIO_MODE_AFSK;
+        frame->baud = RADIO_BAUD_50;
+        strcpy(s, "UUUX");
+        s[3] = 0x80;
+        telemetry_format(&s[4], &telem);
+    }
+    radio_frame_submit(frame);
+}
+
+int main(int argc, char** argv)
+{
+    int rtty = 1, binary = 1, levels = 2, opt;
+
+    while( (opt = getopt(argc, argv, "r:b:l:")) != -1 )
+    {
+        switch(opt)
+        {
+            case 'r': rtty = atoi(optarg); break;
+            case 'b': binary = atoi(optarg); break;
+            case 'l':
+                levels = atoi(optarg);
+                binary_mode = levels == 8 ? RADIO_MODE_8FSK :
+                    levels == 4 ? RADIO_MODE_4FSK : RADIO_MODE_FSK;
+                break;
+            default:
+                levels = 0;
+                break;
+        }
+    }
+    if( levels != 2 && levels != 4 && levels != 8 )
+    {
+        fprintf(stderr, "usage: %s [-r rtty frames] [-b binary frames] "
+                "[-l levels]\n", argv[0]);
+        return 1;
+    }
+
+    printf("# joey-m dac trace, f_cpu %lu, sample rate %lu\n",
+            (unsigned long)F_CPU, (unsigned long)RADIO_SAMPLE_RATE);
+
+    host_spi_hook = trace_spi;
+    radio_init();
+    radio_set_shift(RADIO_SHIFT_425);
+    radio_tune(RADIO_CENTER_FREQ_434630);
+
+    uint64_t next_sample = TRACE_SAMPLE_CYCLES;
+    uint64_t next_symbol = (uint64_t)(OCR1A + 1) * TRACE_TIMER1_CYCLES;
+    uint64_t stop = 0;
+    uint32_t tick = 0;
+
+    while( !stop || now < stop )
+    {
+        radio_frame_t* frame;
+        if( (rtty || binary) && (frame = radio_frame_get()) )
+        {
+            // RTTY first, then alternate while both are left
+            bool bin = !rtty || (binary && (tick & 1));
+            trace_frame(frame, bin, tick++);
+            if( bin ) binary--; else rtty--;
+        }
+
+        if( next_sample <= next_symbol )
+        {
+            now = next_sample;
+            TIMER2_OVF_vect();
+            next_sample += TRACE_SAMPLE_CYCLES;
+        }
+        else
+        {
+            now = next_symbol;
+            TIMER1_COMPA_vect();
+            next_symbol += (uint64_t)(OCR1A + 1) * TRACE_TIMER1_CYCLES;
+        }
+
+        if( !stop && !rtty && !binary &&
+                radio_frames[0].state == RADIO_FRAME_FREE &&
+                radio_frames[1].state == RADIO_FRAME_FREE )
+            stop = now + TRACE_TAIL_CYCLES;
+    }
+
+    return 0;
+}
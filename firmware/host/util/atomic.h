@@ -0,0 +1,23 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <util/atomic.h>. Nothing preempts the harness, so
+ * the block just runs once.
+ */
+
+#ifndef __HOST_UTIL_ATOMIC_H__
+#define __HOST_UTIL_ATOMIC_H__
+
+#define ATOMIC_RESTORESTATE     0
+#define ATOMIC_FORCEON          1
+
+#define ATOMIC_BLOCK(type) \
+    for(uint8_t __atomic_once = 1; __atomic_once; __atomic_once = 0)
+
+#endif /* __HOST_UTIL_ATOMIC_H__ */
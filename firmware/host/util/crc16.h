@@ -0,0 +1,45 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <util/crc16.h>, the C equivalent given in the
+ * avr-libc documentation.
+ */
+
+#ifndef __HOST_UTIL_CRC16_H__
+#define __HOST_UTIL_CRC16_H__
+
+#include <stdint.h>
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    crc = crc ^ ((uint16_t)data << 8);
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        if( crc & 0x8000 )
+            crc = (crc << 1) ^ 0x1021;
+        else
+            crc <<= 1;
+    }
+    return crc;
+}
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+    data = crc ^ data;
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        if( data & 0x80 )
+            data = (data << 1) ^ 0x07;
+        else
+            data <<= 1;
+    }
+    return data;
+}
+
+#endif /* __HOST_UTIL_CRC16_H__ */
@@ -0,0 +1,20 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <util/delay.h>. Delays return straight away, the
+ * harness drives time through the ISRs instead.
+ */
+
+#ifndef __HOST_UTIL_DELAY_H__
+#define __HOST_UTIL_DELAY_H__
+
+#define _delay_ms(ms)   ((void)(ms))
+#define _delay_us(us)   ((void)(us))
+
+#endif /* __HOST_UTIL_DELAY_H__ */
@@ -0,0 +1,17 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Host stand in for <util/twi.h>. The status codes we use are in
+ * temperature.h.
+ */
+
+#ifndef __HOST_UTIL_TWI_H__
+#define __HOST_UTIL_TWI_H__
+
+#endif /* __HOST_UTIL_TWI_H__ */
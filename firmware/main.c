@@ -9,33 +9,35 @@
 #include <avr/io.h>
 #include <stdio.h>
 #include <util/delay.h>
-#include <avr/eeprom.h>
 #include <avr/interrupt.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <avr/wdt.h>
+#include <util/crc16.h>
 
 #include "led.h"
 #include "radio.h"
 #include "gps.h"
 #include "temperature.h"
+#include "telemetry.h"
+#include "fec.h"
+#include "history.h"
+#include "schedule.h"
+#include "task.h"
+#include "nvm.h"
+#include "recorder.h"
 
-#include "libturbohab.h"
 #include "cmp.h"
 
 // 30kHz range on COARSE, 3kHz on FINE
 
-char s[100];
-uint8_t sb[100];
-uint32_t EEMEM ticks = 0;
-
-char debug[100];
-
-#define HB_BUF_LEN 100
+// Only what fits in one coded frame is sent, so packing stops there. The
+// last two bytes of the frame are a CRC of the map and its padding.
+#define HB_BUF_LEN FEC_IN_BYTES
+#define HB_MAP_LEN (HB_BUF_LEN - 2)
 uint8_t hb_buf[HB_BUF_LEN] = {0};
 uint8_t hb_buf_ptr = 0;
-uint8_t hb_buf_out[3*HB_BUF_LEN] = {0};
 
 
 static bool read_bytes(void *data, size_t sz, FILE *fh) {
@@ -48,7 +50,7 @@ static bool file_reader(cmp_ctx_t *ctx, void *data, size_t limit) {
 
 static size_t file_writer(cmp_ctx_t *ctx, const void *data, size_t count) {
 
-	if (hb_buf_ptr+count > HB_BUF_LEN)
+	if (hb_buf_ptr+count > HB_MAP_LEN)
 		return -1;
 		
 	for (uint16_t i = 0; i < count; i++)
@@ -81,6 +83,253 @@ void TxStr(char *str)
 }
 
 
+/**
+ * Fill a frame with the UKHAS sentence, the checksum is added on air.
+ */
+void build_rtty_frame(radio_frame_t* frame, telemetry_t* telem)
+{
+    char* s = (char*)frame->data;
+
+    strcpy(s, "UUUX");
+    s[3] = 0x80;  //null with 7n2
+    telemetry_format(&s[4], telem);
+}
+
+/**
+ * Fill a frame with the sync word then the MessagePack telemetry map,
+ * channel coded. The position under key 3 anchors the older fixes under
+ * key 6, as many as fit in what is left of the payload. Keys 0 to 5 are
+ * laid out as they always have been, so older decoders still read them.
+ * The payload ends in the CRC-16 of the rest, big endian, so the ground
+ * can tell a good frame from a corrupted one that still unpacks.
+ */
+void build_binary_frame(radio_frame_t* frame, telemetry_t* telem)
+{
+    memset((void*)hb_buf,0,HB_BUF_LEN);
+    memset((void*)frame->data,0,RADIO_FRAME_LEN);
+
+    cmp_ctx_t cmp;
+    hb_buf_ptr = 0;
+    cmp_init(&cmp, (void*)hb_buf, file_reader, file_writer);
+
+    cmp_write_map(&cmp, 7);
+
+    // The id has always been nine bytes, padded with nulls
+    char id[9] = TELEMETRY_CALLSIGN;
+    cmp_write_uint(&cmp, 0);
+    cmp_write_str(&cmp, id, sizeof(id));
+
+    cmp_write_uint(&cmp, 1);
+    cmp_write_uint(&cmp, telem->tick);
+
+    cmp_write_uint(&cmp, 2);
+    cmp_write_uint(&cmp, (uint32_t)telem->hour*(3600) +
+            (uint32_t)telem->minute*60 + (uint32_t)telem->second);
+
+    cmp_write_uint(&cmp, 3);
+    cmp_write_array(&cmp, 3);
+    cmp_write_sint(&cmp, telem->lat);
+    cmp_write_sint(&cmp, telem->lon);
+    cmp_write_sint(&cmp, telem->alt / 1000);
+
+    cmp_write_uint(&cmp, 4);
+    cmp_write_uint(&cmp, telem->sats);
+
+    cmp_write_uint(&cmp, 5);
+    cmp_write_uint(&cmp, telem->lock);
+
+    // The key and a bin8 header take three bytes. Without room for them
+    // key 6 is left out, and the map header says one key fewer.
+    if( hb_buf_ptr + 3 <= HB_MAP_LEN )
+    {
+        uint8_t history[HB_MAP_LEN];
+        uint8_t len = history_pack(history, HB_MAP_LEN - hb_buf_ptr - 3,
+                telem);
+        cmp_write_uint(&cmp, 6);
+        cmp_write_bin(&cmp, history, len);
+    }
+    else
+    {
+        uint8_t end = hb_buf_ptr;
+        hb_buf_ptr = 0;
+        cmp_write_map(&cmp, 6);
+        hb_buf_ptr = end;
+    }
+
+    uint16_t crc = 0xFFFF;
+    for(uint8_t i = 0; i < HB_MAP_LEN; i++)
+        crc = _crc_xmodem_update(crc, hb_buf[i]);
+    hb_buf[HB_MAP_LEN] = crc >> 8;
+    hb_buf[HB_MAP_LEN + 1] = crc & 0xFF;
+
+    for(uint8_t i = 0; i < RADIO_SYNC_BYTES; i++)
+        frame->data[i] = RADIO_BINARY_SYNC >> (8 * (RADIO_SYNC_BYTES - 1 - i));
+
+    frame->bits = RADIO_SYNC_BYTES * 8 +
+        fec_encode(hb_buf, &frame->data[RADIO_SYNC_BYTES]);
+}
+
+// Payload builders indexed by RADIO_FRAME_*
+static void (*const builders[])(radio_frame_t*, telemetry_t*) = {
+    build_rtty_frame,
+    build_binary_frame,
+};
+
+// Shared between the tasks, which never run at the same time
+static telemetry_t telem = {0};
+static radio_frame_t* pending = NULL;
+static schedule_slot_t slot = {0};
+static bool fix_fresh = false;
+
+/**
+ * Pick up whatever the GPS has pushed since last time round. The ring
+ * holds about 30ms of bytes at 38400 baud.
+ */
+static void task_gps(void)
+{
+    gps_fix_t fix;
+
+    // Check that we're in airborne <1g mode
+  //  if( gps_check_nav() != 0x06 ) led_set(LED_RED, 1);
+
+    gps_update();
+    if( !gps_get_fix(&fix) ) return;
+
+    bool usable = fix.lock == 0x02 || fix.lock == 0x03 || fix.lock == 0x04;
+
+    // Green while there is no position, so a missing lock shows on the pad
+    led_set(LED_GREEN, !usable);
+    fix_fresh = true;
+    telem.lock = fix.lock;
+    telem.sats = fix.sats;
+    if( usable )
+    {
+        telem.lat = fix.lat;
+        telem.lon = fix.lon;
+        telem.alt = fix.alt;
+        telem.hour = fix.hour;
+        telem.minute = fix.minute;
+        telem.second = fix.second;
+        history_add(&telem);
+        recorder_add(&telem);
+    }
+}
+
+/**
+ * Take the last TMP100 reading and start the next, the TWI interrupt
+ * does the rest.
+ */
+static void task_sensors(void)
+{
+    telem.temperature = temperature_get();
+    temperature_start();
+}
+
+/**
+ * Move logged fixes on from RAM to the EEPROM as it frees up.
+ */
+static void task_recorder(void)
+{
+    recorder_flush();
+}
+
+/**
+ * Keep the radio fed: fill the free frame buffer while the other is on
+ * air. If the queued frame has not started yet, rebuild it whenever a
+ * newer fix arrives so it goes out with the latest position.
+ */
+static void task_frame(void)
+{
+    radio_frame_t* frame = NULL;
+
+    if( pending && fix_fresh && radio_frame_reclaim(pending) )
+    {
+        frame = pending;
+    }
+    else if( (frame = radio_frame_get()) )
+    {
+        // New frame, so increment the system tick
+        telem.tick++;
+        if (telem.tick>18000)
+            telem.tick = 0;
+        nvm_set(telem.tick);
+
+        // A rebuilt frame keeps its slot, only new ones move on
+        schedule_next(&slot, telem.alt / 1000);
+    }
+    fix_fresh = false;
+
+    if( frame )
+    {
+        frame->type = slot.type;
+        frame->mode = slot.mode;
+        frame->baud = slot.baud;
+        builders[slot.type](frame, &telem);
+        radio_frame_submit(frame);
+        pending = frame;
+    }
+}
+
+#if TASK_REPORT
+static void task_report(void);
+#endif
+
+static const task_t tasks[] = {
+    {"gps",      task_gps,      TASK_MS(10)},
+    {"sensors",  task_sensors,  TASK_MS(1000)},
+    {"frame",    task_frame,    TASK_MS(10)},
+    {"recorder", task_recorder, TASK_MS(100)},
+#if TASK_REPORT
+    {"report",   task_report,   TASK_MS(2500)},
+#endif
+};
+#define TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+task_stat_t stats[TASKS];
+
+#if TASK_REPORT
+/**
+ * Task timings in counts of TASK_COUNT_CYCLES as whole microseconds.
+ */
+static char* _report_us(char* p, uint32_t counts)
+{
+    p = _telemetry_uint(p, counts * TASK_COUNT_CYCLES / (F_CPU / 1000000), 1);
+    strcpy(p, " us");
+    return p + 3;
+}
+
+/**
+ * Send one task's stats out of the USART, the next task each time, as
+ * "# gps 1234 runs, avg 20 us, max 56 us, 0 missed". Only built with
+ * TASK_REPORT=1 for the bench: each line busy waits about 15ms, which
+ * the 10ms tasks count as a miss, and the GPS receives it too.
+ */
+static void task_report(void)
+{
+    static uint8_t next = 0;
+    char line[80];
+    char* p = line;
+    const char* name = tasks[next].name;
+    task_stat_t* s = &stats[next];
+
+    *p++ = '#';
+    *p++ = ' ';
+    while(*name) *p++ = *name++;
+    *p++ = ' ';
+    p = _telemetry_uint(p, s->runs, 1);
+    strcpy(p, " runs, avg ");
+    p = _report_us(p + 11, s->runs ? s->time / s->runs : 0);
+    strcpy(p, ", max ");
+    p = _report_us(p + 6, s->max_time);
+    strcpy(p, ", ");
+    p = _telemetry_uint(p + 2, s->misses, 1);
+    strcpy(p, " missed\r\n");
+    TxStr(line);
+
+    if( ++next >= TASKS ) next = 0;
+}
+#endif
+
 int main()
 {
     // Disable, configure, and start the watchdog timer
@@ -94,11 +343,11 @@ int main()
     temperature_init();
     radio_init();
     gps_init();
+    schedule_init();
     radio_enable();
 
     // Set the radio shift and baud rate
-    _radio_dac_write(RADIO_COARSE, RADIO_CENTER_FREQ_434630);
-    _radio_dac_write(RADIO_FINE, 0);
+    radio_tune(RADIO_CENTER_FREQ_434630);
     radio_set_shift(RADIO_SHIFT_425);
     radio_set_baud(RADIO_BAUD_50);
 
@@ -108,127 +357,18 @@ int main()
         radio_chatter();
         wdt_reset();
     }
-	
-	
-    
-    int32_t lat = 0, lon = 0, alt = 0;
-    uint8_t hour = 0, minute = 0, second = 0, lock = 0, sats = 0;
-
-	uint8_t toggle = 0;
-	
+
+    nvm_init();
+    recorder_init();
+    telem.tick = nvm_get();
+    task_init(tasks, stats, TASKS);
+
     while(true)
     {
-        
-
-        // Get the current system tick and increment
-        uint32_t tick = eeprom_read_dword(&ticks) + 1;
-
-        // Get temperature from the TMP100
-        float temperature;
-		if (toggle == 0)
-		    temperature = temperature_read();
-            
-        led_set(LED_GREEN, 1);
-
-        // Check that we're in airborne <1g mode
-      //  if( gps_check_nav() != 0x06 ) led_set(LED_RED, 1);
-
-        // Get information from the GPS
-        gps_check_lock(&lock, &sats);
-        if( lock == 0x02 || lock == 0x03 || lock == 0x04 )
-        {
-            gps_get_position(&lat, &lon, &alt);
-            gps_get_time(&hour, &minute, &second);
-        }
-
-        led_set(LED_GREEN, 0);
-
-        // Format the telemetry string & transmit
-        double lat_fmt = (double)lat / 10000000.0;
-        double lon_fmt = (double)lon / 10000000.0;
-        alt /= 1000;
-
-		if (1)//(toggle==0) //rtty
-		{
-			toggle = 1;
-			set_afsk();
-            set_baud_50();
-		
-			sprintf(s, "UUUX$$UKHAS14,%lu,%02u:%02u:%02u,%02.7f,%03.7f,%ld,%.1f,%u,%x",
-				tick, hour, minute, second, lat_fmt, lon_fmt, alt, temperature,
-				sats, lock);
-			s[3] = 0x80;  //null with 7n2
-			//radio_chatter();
-			radio_transmit_sentence(s);
-			//radio_chatter();
-		
-		}
-		else  //binary
-		{
-			toggle++;
-			if (toggle > 0)
-				toggle = 0;
-            set_baud_300();
-			//set_afsk();
-		
-			memset((void*)hb_buf,0,100);
-			memset((void*)hb_buf_out,0,300);
-		
-			cmp_ctx_t cmp;
-			hb_buf_ptr = 0;
-			cmp_init(&cmp, (void*)hb_buf, file_reader, file_writer);
-		
-			//cmp_write_array(&cmp, 2);
-			//cmp_write_str(&cmp, "Hello", 5);
-			//cmp_write_str(&cmp, "MessagePack", 11);
-			
-			cmp_write_map(&cmp, 6);
-			
-			
-			cmp_write_uint(&cmp, 0);
-			cmp_write_str(&cmp, "UKHAS14", 9);
-			
-			cmp_write_uint(&cmp, 1);
-			cmp_write_uint(&cmp, tick);
-			
-			cmp_write_uint(&cmp, 2);
-			cmp_write_uint(&cmp, (uint32_t)hour*(3600) + (uint32_t)minute*60 + (uint32_t)second);
-			
-			cmp_write_uint(&cmp, 3);
-			cmp_write_array(&cmp, 3);
-			cmp_write_sint(&cmp, lat);
-			cmp_write_sint(&cmp, lon);
-			cmp_write_sint(&cmp, alt);
-			
-			cmp_write_uint(&cmp, 4);
-			cmp_write_uint(&cmp, sats);
-			
-			cmp_write_uint(&cmp, 5);
-			cmp_write_uint(&cmp, lock);
-			
-			//cmp_write_uint(&cmp, 10);
-			//cmp_write_uint(&cmp, 120);
-		
-
-			uint16_t l = channel_encode(hb_buf,hb_buf_out,376,INT_C_376,3);
-			
-			//snprintf(debug,100,"LEN: %d",l);
-			//TxStr(debug);
-			radio_transmit_sentence_binary(hb_buf_out,l);
-			
-			
-			
-			if (toggle == 0)
-				set_fsk();
-		
-		}
+        task_run();
 
         led_set(LED_RED, 0);
-        if (tick>18000)
-            tick = 0;
-        eeprom_update_dword(&ticks, tick);
         wdt_reset();
-        //_delay_ms(500);
     }
 
     return 0;
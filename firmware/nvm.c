@@ -0,0 +1,219 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "nvm.h"
+
+// What EE_READY_vect is doing
+#define NVM_IDLE            0
+#define NVM_COUNTER         1   // a slot of the ring
+#define NVM_BLOCK           2   // a block from nvm_write()
+
+// Each save goes in the slot after the last, so no byte of EEPROM sees
+// more than one write in NVM_SLOTS
+nvm_slot_t EEMEM nvm_ring[NVM_SLOTS];
+
+// The counter, and whether it has changed since the last save started
+volatile uint32_t _nvm_value = 0;
+volatile bool _nvm_dirty = false;
+
+// A block another module has queued, written after any counter save
+uint8_t _nvm_block[NVM_BLOCK_MAX];
+uint8_t* _nvm_block_dst;
+volatile uint8_t _nvm_block_len = 0;
+
+// What EE_READY_vect is writing out a byte at a time
+volatile uint8_t _nvm_job = NVM_IDLE;
+const uint8_t* _nvm_src;
+uint16_t _nvm_dst;
+uint8_t _nvm_len;
+uint8_t _nvm_pos;
+
+// The last counter slot written
+uint8_t _nvm_slot = NVM_SLOTS - 1;
+uint8_t _nvm_seq = 0;
+nvm_slot_t _nvm_pending;
+
+static uint8_t _nvm_check(const nvm_slot_t* slot)
+{
+    const uint8_t* p = (const uint8_t*)slot;
+    uint8_t crc = 0xFF;
+
+    for(uint8_t i = 0; i < offsetof(nvm_slot_t, check); i++)
+        crc = _crc8_ccitt_update(crc, p[i]);
+    return crc;
+}
+
+bool _nvm_valid(const nvm_slot_t* slot)
+{
+    return slot->check == _nvm_check(slot);
+}
+
+/**
+ * Find the newest good slot: the last of a run of good slots with
+ * sequence numbers counting up by one. A slot that was being written
+ * when the power went fails its check and is passed over. Nothing good
+ * at all, as in a new part, starts the counter at zero.
+ */
+void nvm_init(void)
+{
+    nvm_slot_t ring[NVM_SLOTS];
+    eeprom_read_block(ring, nvm_ring, sizeof(ring));
+
+    _nvm_value = 0;
+    _nvm_slot = NVM_SLOTS - 1;
+    _nvm_seq = 0;
+
+    for(uint8_t i = 0; i < NVM_SLOTS; i++)
+    {
+        const nvm_slot_t* s = &ring[i];
+        const nvm_slot_t* next = &ring[(i + 1) % NVM_SLOTS];
+
+        if( !_nvm_valid(s) ) continue;
+        if( _nvm_valid(next) && next->seq == (uint8_t)(s->seq + 1) )
+            continue;
+
+        _nvm_value = s->value;
+        _nvm_slot = i;
+        _nvm_seq = s->seq;
+        break;
+    }
+}
+
+/**
+ * The counter as of the last nvm_set(), from RAM.
+ */
+uint32_t nvm_get(void)
+{
+    uint32_t v;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        v = _nvm_value;
+    }
+    return v;
+}
+
+/**
+ * Change the counter and save it in the background. If a save is
+ * already going the new value follows it, so only the latest is ever
+ * written and this never waits for the EEPROM.
+ */
+void nvm_set(uint32_t value)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _nvm_value = value;
+        _nvm_dirty = true;
+        if( _nvm_job == NVM_IDLE ) _nvm_next();
+    }
+}
+
+/**
+ * Copy up to NVM_BLOCK_MAX bytes to write to dst in the EEPROM in the
+ * background. Only one block is held at a time, so this returns false
+ * without taking it if the last one has not finished. All EEPROM writes
+ * after start up have to come through here, EE_READY_vect owns the
+ * EEPROM registers.
+ */
+bool nvm_write(void* dst, const void* src, uint8_t len)
+{
+    bool taken = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if( !_nvm_block_len && len <= NVM_BLOCK_MAX )
+        {
+            memcpy(_nvm_block, src, len);
+            _nvm_block_dst = dst;
+            _nvm_block_len = len;
+            taken = true;
+            if( _nvm_job == NVM_IDLE ) _nvm_next();
+        }
+    }
+    return taken;
+}
+
+/**
+ * True while anything is being written.
+ */
+bool nvm_busy(void)
+{
+    return _nvm_job != NVM_IDLE;
+}
+
+/**
+ * Start on the next thing to write, the counter first as it is small
+ * and matters most. Called with interrupts off.
+ */
+void _nvm_next(void)
+{
+    if( _nvm_dirty )
+    {
+        _nvm_slot = (_nvm_slot + 1) % NVM_SLOTS;
+        _nvm_seq++;
+        _nvm_pending.value = _nvm_value;
+        _nvm_pending.seq = _nvm_seq;
+        _nvm_pending.check = _nvm_check(&_nvm_pending);
+        _nvm_dirty = false;
+
+        _nvm_job = NVM_COUNTER;
+        _nvm_src = (const uint8_t*)&_nvm_pending;
+        _nvm_dst = (uint16_t)(uintptr_t)&nvm_ring[_nvm_slot];
+        _nvm_len = sizeof(nvm_slot_t);
+    }
+    else if( _nvm_block_len )
+    {
+        _nvm_job = NVM_BLOCK;
+        _nvm_src = _nvm_block;
+        _nvm_dst = (uint16_t)(uintptr_t)_nvm_block_dst;
+        _nvm_len = _nvm_block_len;
+    }
+    else
+    {
+        _nvm_job = NVM_IDLE;
+        EECR &= ~_BV(EERIE);
+        return;
+    }
+    _nvm_pos = 0;
+
+    // Fires as soon as the EEPROM is ready, which it usually already is
+    EECR |= _BV(EERIE);
+}
+
+/**
+ * Write the next byte each time the EEPROM is ready. A counter slot
+ * has its check byte last. Bytes that already hold the right value are
+ * left alone to save wear.
+ */
+ISR(EE_READY_vect)
+{
+    while( _nvm_pos < _nvm_len )
+    {
+        EEAR = _nvm_dst + _nvm_pos;
+        EECR |= _BV(EERE);
+        uint8_t b = _nvm_src[_nvm_pos++];
+        if( EEDR == b ) continue;
+
+        EEDR = b;
+        EECR |= _BV(EEMPE);
+        EECR |= _BV(EEPE);
+        return;
+    }
+
+    // Done, free the block for the next and go on to whatever is waiting
+    if( _nvm_job == NVM_BLOCK ) _nvm_block_len = 0;
+    _nvm_next();
+}
@@ -0,0 +1,40 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __NVM_H__
+#define __NVM_H__
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+// Slots in the EEPROM ring the counter is spread over, fewer than 256 so
+// the sequence numbers show where the ring wraps
+#define NVM_SLOTS           32
+
+// Largest block nvm_write() takes
+#define NVM_BLOCK_MAX       16
+
+/**
+ * One saved copy of the counter
+ */
+typedef struct
+{
+    uint32_t value;
+    uint8_t seq;            // one more than the slot before
+    uint8_t check;          // CRC-8 of the above, written last
+} nvm_slot_t;
+
+void nvm_init(void);
+uint32_t nvm_get(void);
+void nvm_set(uint32_t value);
+bool nvm_write(void* dst, const void* src, uint8_t len);
+bool nvm_busy(void);
+bool _nvm_valid(const nvm_slot_t* slot);
+void _nvm_next(void);
+
+#endif /* __NVM_H__ */
@@ -12,71 +12,85 @@
 #include <util/delay.h>
 #include <avr/interrupt.h>
 #include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 #include <avr/wdt.h>
+#include <util/atomic.h>
 #include <util/crc16.h>
 #include "stdbool.h"
 #include "led.h"
 #include "radio.h"
+#include "dac.h"
+#include "transition.h"
 
-uint16_t _radio_shift = 0x0000;
+volatile uint16_t _radio_shift = 0x0000;
 
+// Symbols waiting for the sample engine, pushed by the symbol clock and
+// popped by TIMER2_OVF_vect. Each is the mode in the high nibble and the
+// level in the low nibble.
+volatile uint8_t _radio_sym[RADIO_SYM_QUEUE_LEN];
+volatile uint8_t _radio_sym_head = 0;
+volatile uint8_t _radio_sym_tail = 0;
+
+// Sample engine state, only touched by TIMER2_OVF_vect once running
 volatile uint16_t _dac_value = 0;
-volatile uint8_t sample = 0;
-volatile int32_t _transition_delta = 0;
+volatile uint8_t sample = DSP_SAMPLES;
+volatile uint16_t _transition_delta = 0;
+volatile bool _transition_up = true;
 volatile uint16_t _transition_start = 0;
-volatile bool transition_complete = true;
+volatile uint16_t _transition_target = 0;
+
+// Transmit frames, one on air while main() fills the other
+radio_frame_t radio_frames[2];
+radio_frame_t* volatile _radio_frame = NULL;
+
+_Static_assert(RADIO_FRAME_LEN >= RADIO_RTTY_LEN,
+        "RADIO_FRAME_LEN is too short for an RTTY sentence");
+
+// Symbol clock. Each symbol is _radio_sym_ticks counts of TIMER1 and
+// the remainder builds up in _radio_sym_acc until it is worth one more.
+volatile uint16_t _radio_sym_ticks;
+volatile uint16_t _radio_sym_frac;
+volatile uint16_t _radio_sym_baud;
+volatile uint16_t _radio_sym_acc;
 
 // RTTY stuff
-volatile uint8_t systicks = 0;
 volatile uint8_t _txbyte = 0;
 volatile uint8_t _txptr = 0;
-volatile bool byte_complete = false;
+volatile char* _txstring;
+
+// Streaming checksum, updated as each character goes out
+volatile bool _tx_checksum = false;
+volatile bool _crc_started = false;
+volatile uint16_t _crc = 0xFFFF;
+char _tx_trailer[7];
 
 volatile uint16_t bits_remain = 0;
 volatile uint8_t *binary_seq;
 volatile uint8_t out_mask = 0x80;
+volatile uint8_t _radio_sym_bits = 1;
 
-volatile uint8_t radio_mode = 0;   //0-fsk; 1-afsk
-
-uint8_t EEMEM step[50] = {4, 7, 11, 15, 19, 23, 28, 32, 37, 42, 47, 52, 57, 
-    62, 67, 73, 78, 84, 90, 95, 101, 107, 113, 119, 125, 130, 136, 142, 148,
-    154, 160, 165, 171, 177, 182, 188, 193, 198, 203, 208, 213, 218, 223, 227, 
-    232, 236, 240, 244, 248, 251};
-
-#define SIN_FULL_LEN 250
-#define SIN_HALF_LEN 125	 //todo: use symmetry (not really much point in going 1/2 -> 1/4 sine)
-const static uint8_t sin_table[SIN_HALF_LEN] = {128, 131, 134, 137, 140, 143, 146, 
-	149, 152, 156, 159, 162, 165, 168, 171, 173, 176, 179, 182, 185, 188, 190, 193, 
-	196, 198, 201, 203, 206, 208, 211, 213, 215, 218, 220, 222, 224, 226, 228, 230, 
-	231, 233, 235, 236, 238, 239, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 
-	250, 251, 251, 252, 252, 252, 252, 252, 252, 252, 252, 252, 252, 251, 251, 250, 
-	250, 249, 248, 247, 246, 245, 244, 243, 242, 241, 239, 238, 236, 235, 233, 231, 
-	230, 228, 226, 224, 222, 220, 218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 
-	193, 190, 188, 185, 182, 179, 176, 173, 171, 168, 165, 162, 159, 156, 152, 149, 
-	146, 143, 140, 137, 134, 131};/*, 128, 124, 121, 118, 115, 112, 109, 106, 103, 99, 
-	96, 93, 90, 87, 84, 82, 79, 76, 73, 70, 67, 65, 62, 59, 57, 54, 52, 49, 47, 44, 
-	42, 40, 37, 35, 33, 31, 29, 27, 25, 24, 22, 20, 19, 17, 16, 14, 13, 12, 11, 10, 
-	9, 8, 7, 6, 5, 5, 4, 4, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 5, 5, 6, 7, 8, 9, 10, 
-	11, 12, 13, 14, 16, 17, 19, 20, 22, 24, 25, 27, 29, 31, 33, 35, 37, 40, 42, 44, 
-	47, 49, 52, 54, 57, 59, 62, 65, 67, 70, 73, 76, 79, 82, 84, 87, 90, 93, 96, 99, 
-	103, 106, 109, 112, 115, 118, 121, 124}; */
-
-#define FREQ_HIGH 4
-#define FREQ_LOW 3	
-	
-volatile uint8_t sin_phase;
-volatile uint8_t sin_phase_inc = FREQ_HIGH;
-
-
-void set_afsk()
-{
-	radio_mode = 1;	
-}
+// Level for each group of bits, so neighbouring levels only differ by
+// one bit. 4FSK uses the first four.
+const uint8_t _radio_gray[8] PROGMEM = {0, 1, 3, 2, 7, 6, 4, 5};
+
+// Modulation the sample engine is currently producing
+volatile uint8_t radio_mode = RADIO_MODE_FSK;
+
+
+// First quarter of a sine wave of amplitude 124 about 128, sampled at the
+// middle of each of the 64 steps so the other quarters are exact mirrors
+const uint8_t sin_quarter[64] PROGMEM = {2, 5, 8, 11, 14, 17, 20, 23, 26,
+    29, 32, 35, 37, 40, 43, 46, 49, 52, 54, 57, 60, 62, 65, 68, 70, 73, 75,
+    77, 80, 82, 84, 87, 89, 91, 93, 95, 97, 99, 100, 102, 104, 106, 107, 109,
+    110, 111, 113, 114, 115, 116, 117, 118, 119, 120, 121, 121, 122, 122, 123,
+    123, 124, 124, 124, 124};
+
+// AFSK phase accumulator, one full cycle is 65536
+volatile uint16_t dds_phase = 0;
+volatile uint16_t dds_inc = RADIO_DDS_INC(RADIO_AFSK_MARK);
+uint16_t _afsk_mark_inc = RADIO_DDS_INC(RADIO_AFSK_MARK);
+uint16_t _afsk_space_inc = RADIO_DDS_INC(RADIO_AFSK_SPACE);
 
-void set_fsk()
-{
-	radio_mode = 0;	
-}
 
 /**
  * Initialise the radio subsystem including the dual 16 bit 
@@ -84,40 +98,25 @@ void set_fsk()
  */
 void radio_init(void)
 {
-    // Configure the slave select pin and set it high
-    RADIO_DDR |= _BV(RADIO_SS) | _BV(RADIO_MOSI) | _BV(RADIO_SCK);
-    RADIO_DDR &= ~(_BV(RADIO_MISO));
-    RADIO_PORT |= _BV(RADIO_SS);
-
-    // Set MSB first, sample on rising edge, 
-    // clock idles low
-    SPCR &= ~(_BV(DORD) | _BV(CPOL) | _BV(CPHA));
-
-    // Enable SPI, set master mode and fosc/2, giving an SPI
-    // interface SCK speed of 8MHz
-    SPSR |= _BV(SPI2X);
-    SPCR &= ~(_BV(SPR0) | _BV(SPR1));
-    SPCR |= _BV(MSTR) | _BV(SPE);
+    // Bring up the SPI link to the DAC
+    dac_init();
 
-    // Set up TIMER0 to tick once per symbol and interrupt
-    // CTC mode
-    TCCR0A |= _BV(WGM01);
+    // Set up TIMER1 to tick once per symbol and interrupt, CTC mode
+    // prescaled by 8
+    TCCR1B |= _BV(WGM12) | _BV(CS11);
 
-    // Prescale by 1024
-    TCCR0B |= _BV(CS02) | _BV(CS00);
-
-    // Interrupt on compare match with OCR0A
-    set_baud_50();
+    // Interrupt on compare match with OCR1A. The ISR runs all the time
+    // and idles until a frame is submitted
+    radio_set_baud(RADIO_BAUD_50);
+    TIMSK1 |= _BV(OCIE1A);
 
     // Set up TIMER2 for the DSP (!) stuff
     // No clock prescale to get 62.5kHz sample rate with an 8 bit timer
     TCCR2B |= _BV(CS20);
 
-    // Do not interrupt on overflow for now
-    TIMSK2 &= ~(_BV(TOIE2));
-	
-	//now turn on interrupts :P
-	TIMSK2 |= _BV(TOIE2);
+    // The sample engine runs all the time and is the only writer of the
+    // FINE channel
+    TIMSK2 |= _BV(TOIE2);
 
     // Turn off the DAC
     _radio_dac_off();
@@ -126,16 +125,6 @@ void radio_init(void)
     sei();
 }
 
-void set_baud_50(void)
-{
-    OCR0A = 156;
-}
-
-void set_baud_300(void)
-{
-    OCR0A = 25;
-}
-
 /**
  * Enable the power amplifier on the Micrel radio
  */
@@ -156,26 +145,20 @@ void radio_disable(void)
 }
 
 /**
- * Write a value to one of the DAC channels
+ * Retune the carrier with the COARSE channel, rewriting FINE with the
+ * value the sample engine last wrote so both outputs move in a single
+ * update.
  */
-void _radio_dac_write(uint8_t channel, uint16_t value)
+void radio_tune(uint16_t coarse)
 {
-    // Take SS low
-    RADIO_PORT &= ~(_BV(RADIO_SS));
-
-    // Write cmd then value to the SPI data register
-    SPDR = 0x30 | (channel & 0x01);
-    while(!(SPSR & _BV(SPIF)));
-    SPDR = value >> 8;
-    while(!(SPSR & _BV(SPIF)));
-    SPDR = value & 0xFF;
-    while(!(SPSR & _BV(SPIF)));
-
-    // Raise SS to signal end of transaction
-    RADIO_PORT |= _BV(RADIO_SS);
-
-    // Update the DAC value
-    if(channel == RADIO_FINE) _dac_value = value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+#if RADIO_COARSE == DAC_A
+        dac_write_both(coarse, _dac_value);
+#else
+        dac_write_both(_dac_value, coarse);
+#endif
+    }
 }
 
 /**
@@ -183,80 +166,215 @@ void _radio_dac_write(uint8_t channel, uint16_t value)
  */
 void _radio_dac_off(void)
 {
-    // Take SS low
-    RADIO_PORT &= ~(_BV(RADIO_SS));
-
-    // Write cmd then value to the SPI data register
-    SPDR = 0x4F;
-    while(!(SPSR & _BV(SPIF)));
-    SPDR = 0;
-    while(!(SPSR & _BV(SPIF)));
-    SPDR = 0;
-    while(!(SPSR & _BV(SPIF)));
-
-    // Raise SS to signal end of transaction
-    RADIO_PORT |= _BV(RADIO_SS);
+    dac_off();
 }
 
 /**
- * Transmit the given string over the radio terminated with a checksum
- * and a newline, compatible with the UKHAS habitat listener and parser.
+ * Return a frame buffer for main() to fill, or NULL if one is already
+ * queued behind the frame on air.
  */
-void radio_transmit_sentence(char* string)
+radio_frame_t* radio_frame_get(void)
 {
-    radio_transmit_string(string);
-    
-    // Calculate the checksum and send it
-    uint16_t checksum = radio_calculate_checksum(string);
-    char cs[7];
-    sprintf(cs, "*%04X\n", checksum);
-    radio_transmit_string(cs);
+    radio_frame_t* frame = NULL;
+
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        if( radio_frames[i].state == RADIO_FRAME_READY ) return NULL;
+        if( radio_frames[i].state == RADIO_FRAME_FREE )
+            frame = &radio_frames[i];
+    }
+    return frame;
 }
 
-void radio_transmit_sentence_binary(uint8_t* string, uint16_t bits)
+/**
+ * Take back a submitted frame so it can be rebuilt with fresher data.
+ * Fails once the ISR has started sending it.
+ */
+bool radio_frame_reclaim(radio_frame_t* frame)
 {
-    TIMSK2 |= _BV(TOIE2);
-	bits_remain = bits;
-	binary_seq = string;
-	out_mask = 0x80;
-	TIMSK0 |= _BV(OCIE0A);
-	while (bits_remain & 0xFF00);
-	while (bits_remain & 0x00FF);
-	//while(1)
-	//{
-	//	_delay_ms(10);
-	//	cli();
-	//	if (bits_remain == 0)
-	//		break;
-	//	sei();
-	//}
-	
-	while ( !( UCSR0A & (1<<UDRE0)) );
-	UDR0 = 'J';
-	while ( !( UCSR0A & (1<<UDRE0)) );
-	UDR0 = (bits_remain&0xFF) + 48;
-
-
-	//TIMSK0 &= ~(_BV(OCIE0A));
+    bool reclaimed = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if( frame->state == RADIO_FRAME_READY )
+        {
+            frame->state = RADIO_FRAME_FREE;
+            reclaimed = true;
+        }
+    }
+    return reclaimed;
+}
 
+/**
+ * Queue a filled frame. RTTY frames hold a null terminated sentence which
+ * gets the checksum trailer appended on air, binary frames hold bits,
+ * MSB first. The symbol period is worked out here so the ISR never has
+ * to divide.
+ */
+void radio_frame_submit(radio_frame_t* frame)
+{
+    uint16_t max = radio_baud_max(frame->mode);
+
+    if( frame->baud < RADIO_BAUD_MIN ) frame->baud = RADIO_BAUD_MIN;
+    if( frame->baud > max ) frame->baud = max;
+    uint16_t ticks = RADIO_SYMBOL_CLOCK / frame->baud;
+    uint16_t frac = RADIO_SYMBOL_CLOCK % frame->baud;
+
+    // Everything written to the frame has to land before the symbol ISR
+    // can see it is ready, and the block stops the compiler moving any
+    // of it past the state. The divides stay outside so the sample
+    // engine is never held off for long.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        frame->sym_ticks = ticks;
+        frame->sym_frac = frac;
+        frame->state = RADIO_FRAME_READY;
+    }
 }
 
+/**
+ * Called from the symbol ISR to put a queued frame on air, switching to
+ * its modulation and baud rate.
+ */
+void _radio_start_frame(radio_frame_t* frame)
+{
+    frame->state = RADIO_FRAME_ON_AIR;
+    _radio_sym_ticks = frame->sym_ticks;
+    _radio_sym_frac = frame->sym_frac;
+    _radio_sym_baud = frame->baud;
+    _radio_sym_acc = 0;
+
+    if( frame->type == RADIO_FRAME_BINARY )
+    {
+        bits_remain = frame->bits;
+        binary_seq = frame->data;
+        out_mask = 0x80;
+
+        if( frame->mode == RADIO_MODE_4FSK )
+            _radio_sym_bits = 2;
+        else if( frame->mode == RADIO_MODE_8FSK )
+            _radio_sym_bits = 3;
+        else
+            _radio_sym_bits = 1;
+    }
+    else
+    {
+        _txstring = (char*)frame->data;
+        _tx_checksum = true;
+        _crc_started = false;
+        _crc = 0xFFFF;
+
+        // Start on a character boundary so the first symbol loads the
+        // first character
+        _txptr = 10;
+    }
+
+    _radio_frame = frame;
+}
 
 /**
- * Transmit a null terminated string over the radio link.
+ * Called from the symbol ISR to send the next symbol of the frame on
+ * air. Returns false if there is no frame or it has been sent.
  */
-void radio_transmit_string(char* string)
+bool _radio_send_symbol(void)
 {
-    while(*string)
+    if( !_radio_frame ) return false;
+
+    if( _radio_frame->type == RADIO_FRAME_BINARY )
+    {
+        if( bits_remain == 0 ) return false;
+
+        uint8_t bits = _radio_next_bits(_radio_sym_bits);
+        _radio_push_symbol(_radio_frame->mode,
+                pgm_read_byte(&_radio_gray[bits]));
+        return true;
+    }
+
+    // Load the next character straight after the stop bits so there is
+    // no gap between characters
+    if( _txptr >= 10 )
     {
-        _txbyte = *string;
+        if( !_radio_next_char() ) return false;
         _txptr = 0;
-        byte_complete = false;
-        TIMSK0 |= _BV(OCIE0A);
-        while(!byte_complete);
-        wdt_reset();
-        string++;
     }
+
+    _radio_transmit_bit(_txbyte, _txptr);
+    _txptr++;
+    return true;
+}
+
+/**
+ * Take the next count bits of a binary frame, MSB first, padding with
+ * zeros past the end so the last symbol is whole.
+ */
+uint8_t _radio_next_bits(uint8_t count)
+{
+    uint8_t bits = 0;
+
+    while( count-- )
+    {
+        bits <<= 1;
+        if( bits_remain == 0 ) continue;
+
+        if( *binary_seq & out_mask ) bits |= 1;
+        out_mask >>= 1;
+        if (out_mask == 0)
+        {
+            out_mask = 0x80;
+            binary_seq++;
+        }
+        bits_remain--;
+    }
+    return bits;
+}
+
+/**
+ * Called from the symbol ISR to load the next character into _txbyte,
+ * folding it into the checksum. Switches to the trailer at the end of a
+ * sentence and returns false once there is nothing left to send.
+ */
+bool _radio_next_char(void)
+{
+    char c = *_txstring;
+
+    if( c == '\0' && _tx_checksum )
+    {
+        _radio_format_trailer(_tx_trailer, _crc);
+        _txstring = _tx_trailer;
+        _tx_checksum = false;
+        c = *_txstring;
+    }
+
+    if( c == '\0' ) return false;
+
+    // Checksum everything after the first $ except any other $ signs
+    if( _tx_checksum )
+    {
+        if( c == '$' )
+            _crc_started = true;
+        else if( _crc_started )
+            _crc = _crc_xmodem_update(_crc, (uint8_t)c);
+    }
+
+    _txbyte = c;
+    _txstring++;
+    return true;
+}
+
+/**
+ * Write "*XXXX\n" for the given checksum into buf.
+ */
+void _radio_format_trailer(char* buf, uint16_t crc)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    buf[0] = '*';
+    buf[1] = hex[crc >> 12];
+    buf[2] = hex[(crc >> 8) & 0x0F];
+    buf[3] = hex[(crc >> 4) & 0x0F];
+    buf[4] = hex[crc & 0x0F];
+    buf[5] = '\n';
+    buf[6] = '\0';
 }
 
 /**
@@ -268,27 +386,157 @@ void radio_set_shift(uint16_t shift)
 }
 
 /**
- * Set the baud rate by setting the compare value for TIMER0
+ * Set the AFSK mark and space tones in Hz, anything up to half the
+ * sample rate will do.
+ */
+void radio_set_afsk_tones(uint16_t mark, uint16_t space)
+{
+    _afsk_mark_inc = RADIO_DDS_INC(mark);
+    _afsk_space_inc = RADIO_DDS_INC(space);
+}
+
+/**
+ * Fastest baud the mode can be sent at. The FSK modes need a whole
+ * shaped transition inside each symbol, AFSK only enough samples.
+ */
+uint16_t radio_baud_max(uint8_t mode)
+{
+    if( mode == RADIO_MODE_AFSK ) return RADIO_BAUD_MAX;
+    return RADIO_SAMPLE_RATE / DSP_SAMPLES < RADIO_BAUD_MAX ?
+        RADIO_SAMPLE_RATE / DSP_SAMPLES : RADIO_BAUD_MAX;
+}
+
+/**
+ * Set the baud rate the symbol clock idles at and radio_chatter() uses.
+ * Frames bring their own.
+ */
+void radio_set_baud(uint16_t baud)
+{
+    if( baud < RADIO_BAUD_MIN ) baud = RADIO_BAUD_MIN;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _radio_sym_ticks = RADIO_SYMBOL_CLOCK / baud;
+        _radio_sym_frac = RADIO_SYMBOL_CLOCK % baud;
+        _radio_sym_baud = baud;
+        _radio_sym_acc = 0;
+
+        // Restart the count so a shorter period cannot be overshot
+        TCNT1 = 0;
+        _radio_next_period();
+    }
+}
+
+/**
+ * Set the length of the symbol after this one, a count longer whenever
+ * the remainders have added up to a whole one, so over a frame the rate
+ * is exact and no symbol is more than one count out.
  */
-void radio_set_baud(uint8_t baud)
+void _radio_next_period(void)
 {
-    OCR0A = baud;
+    uint16_t ticks = _radio_sym_ticks;
+
+    _radio_sym_acc += _radio_sym_frac;
+    if( _radio_sym_acc >= _radio_sym_baud )
+    {
+        _radio_sym_acc -= _radio_sym_baud;
+        ticks++;
+    }
+    OCR1A = ticks - 1;
 }
 
 /**
- * Transition using the FIR filter
+ * Queue a symbol for the sample engine. There must only be one producer
+ * at a time, the symbol ISR while a frame is on air or radio_chatter()
+ * before any are submitted. Returns false if the queue is full.
  */
-void _radio_transition(uint16_t target)
+bool _radio_push_symbol(uint8_t mode, uint8_t level)
 {
-    if( _dac_value == target ) return;
+    uint8_t next = (_radio_sym_head + 1) & (RADIO_SYM_QUEUE_LEN - 1);
+    if( next == _radio_sym_tail ) return false;
+
+    _radio_sym[_radio_sym_head] = mode << 4 | (level & 0x0F);
+    _radio_sym_head = next;
+    return true;
+}
 
-    // Update the global target and initial
+/**
+ * Start a shaped move of the FINE DAC to target, following the
+ * transition_step table generated at build time.
+ */
+static inline void _radio_transition(uint16_t target)
+{
+    // Keep the size of the move unsigned so the engine only needs a
+    // 16x8 bit multiply
     _transition_start = _dac_value;
-    _transition_delta = (int32_t)target - (int32_t)_transition_start;
-    transition_complete = false;
+    _transition_target = target;
+    _transition_up = target > _transition_start;
+    if( _transition_up )
+        _transition_delta = target - _transition_start;
+    else
+        _transition_delta = _transition_start - target;
+    sample = 0;
+}
 
-    // Start the DSP timer interrupting
-    TIMSK2 |= _BV(TOIE2);
+/**
+ * FSK mapper, each level is a multiple of the shift above the carrier.
+ * The shift has to leave room for level 7 if 8FSK is used.
+ */
+static inline void _radio_fsk_symbol(uint8_t level)
+{
+    _radio_transition(level * _radio_shift);
+}
+
+/**
+ * FSK mapper, follow the step response to the current target and sit
+ * there once it runs out.
+ */
+static inline uint16_t _radio_fsk_sample(void)
+{
+    if( sample >= DSP_SAMPLES ) return _transition_target;
+
+    // delta * step >> 8 exactly, as two 8x8 bit multiplies rather than
+    // a 32 bit one from libgcc
+    uint8_t step = pgm_read_byte(&transition_step[sample]);
+    uint16_t d = (uint16_t)(uint8_t)(_transition_delta >> 8) * step +
+        (((uint16_t)(uint8_t)_transition_delta * step) >> 8);
+    sample++;
+    if( _transition_up )
+        return _transition_start + d;
+    else
+        return _transition_start - d;
+}
+
+/**
+ * AFSK mapper, level 1 is the mark tone and 0 the space. The phase
+ * carries on across symbols.
+ */
+static inline void _radio_afsk_symbol(uint8_t level)
+{
+    if( level )
+        dds_inc = _afsk_mark_inc;
+    else
+        dds_inc = _afsk_space_inc;
+}
+
+/**
+ * AFSK mapper, step the phase accumulator and look up the sine.
+ */
+static inline uint16_t _radio_afsk_sample(void)
+{
+    // Top two bits of the phase pick the quadrant, the next six the
+    // step within it
+    dds_phase += dds_inc;
+    uint8_t p = dds_phase >> 8;
+    uint8_t i = p & 0x3F;
+    if( p & 0x40 )
+        i = 0x3F - i;
+
+    uint8_t a = pgm_read_byte(&sin_quarter[i]);
+    if( p & 0x80 )
+        return (uint16_t)(128 - a) << 8;
+    else
+        return (uint16_t)(128 + a) << 8;
 }
 
 /**
@@ -297,48 +545,37 @@ void _radio_transition(uint16_t target)
  */
 void _radio_transmit_bit(uint8_t data, uint8_t ptr)
 {
-	if (radio_mode){
-		if(ptr == 0)
-			sin_phase_inc = FREQ_LOW; //_radio_transition(0);
-		else if(ptr >= 1 && ptr <= 7)
-			if( (data >> (ptr - 1)) & 1 )
-				sin_phase_inc = FREQ_HIGH; //_radio_transition(_radio_shift);
-			else
-				sin_phase_inc = FREQ_LOW; //_radio_transition(0);
-		else
-			sin_phase_inc = FREQ_HIGH; //_radio_transition(_radio_shift);
-	}
-	else
-	{
-		if(ptr == 0)
-			_radio_dac_write(RADIO_FINE, (uint16_t)0); //_radio_transition(0);
-		else if(ptr >= 1 && ptr <= 7)
-			if( (data >> (ptr - 1)) & 1 )
-				_radio_dac_write(RADIO_FINE, (uint16_t)_radio_shift); //_radio_transition(_radio_shift);
-			else
-				_radio_dac_write(RADIO_FINE, (uint16_t)0); //_radio_transition(0);
-		else
-			_radio_dac_write(RADIO_FINE, (uint16_t)_radio_shift); //_radio_transition(_radio_shift);
-	}
+    if(ptr == 0)
+        _radio_set_tone(0);
+    else if(ptr >= 1 && ptr <= 7)
+        _radio_set_tone((data >> (ptr - 1)) & 1);
+    else
+        _radio_set_tone(1);
 }
 
-
+/**
+ * Queue the high (mark) or low (space) tone in the mode of the frame on
+ * air.
+ */
+void _radio_set_tone(uint8_t high)
+{
+    _radio_push_symbol(_radio_frame->mode, high ? 1 : 0);
+}
 
 /**
  * Calculate the checksum for the radio string excluding any $ signs
- * at the start.
+ * at the start. This matches what the symbol ISR computes on the fly.
  */
 uint16_t radio_calculate_checksum(char* data)
 {
-    uint16_t i = 0;
     uint16_t crc = 0xFFFF;
-   
-    
-    for (i=0; i < strlen(data); i++) {
-        if (data[i] == '$') break;
-    }
-    for (; i < strlen(data); i++) {
-        if (data[i] != '$') crc = _crc_xmodem_update(crc,(uint8_t)data[i]);
+
+    // Skip anything before the first $
+    while( *data && *data != '$' ) data++;
+
+    for( ; *data; data++ )
+    {
+        if( *data != '$' ) crc = _crc_xmodem_update(crc, (uint8_t)*data);
     }
     return crc;
 }
@@ -349,107 +586,92 @@ uint16_t radio_calculate_checksum(char* data)
  */
 void radio_chatter(void)
 {
-    _radio_dac_write(RADIO_FINE, 0x0000);
-    _delay_ms(200);
-    _radio_dac_write(RADIO_FINE, 0xFFFF);
-    _delay_ms(200);
-    _radio_dac_write(RADIO_FINE, 0x0000);
-    _delay_ms(200);
-    _radio_dac_write(RADIO_FINE, 0xFFFF);
-    _delay_ms(200);
+    // Swing the whole range of the FINE channel rather than the shift.
+    // The engine has picked up the last symbol long before the shift is
+    // put back.
+    uint16_t shift = _radio_shift;
+    _radio_shift = 0xFFFF;
+
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        _radio_push_symbol(RADIO_MODE_FSK, i & 1);
+        _delay_ms(200);
+    }
+
+    _radio_shift = shift;
 }
 
 /**
- * Interrupt handle for the radio timer, when we reach the systicks
- * limit we should transmit the next bit
+ * Symbol clock, sends the next symbol of the frame on air
  */
-ISR(TIMER0_COMPA_vect)
+ISR(TIMER1_COMPA_vect)
 {
-    if( systicks < 1 )
-    {
-        systicks++;
-    }
-    else
+    // When a frame finishes, start the queued one on the same tick so
+    // there is no idle time between frames
+    if( !_radio_send_symbol() )
     {
-		if (bits_remain > 0)   //binary protocol
-		{
-		
-			if (radio_mode){
-				if (*binary_seq & out_mask)
-					sin_phase_inc = FREQ_HIGH;
-				else
-					sin_phase_inc = FREQ_LOW;
-			}else{			
-				if (*binary_seq & out_mask)
-					_radio_dac_write(RADIO_FINE, (uint16_t)_radio_shift); //_radio_transition(_radio_shift);
-				else
-					_radio_dac_write(RADIO_FINE, (uint16_t)0); //_radio_transition(0);
-			}
-			
-			//if (*binary_seq & out_mask)
-			//	led_set(LED_RED, 1);
-			//else
-			//	led_set(LED_RED, 0);
-				
-			out_mask >>= 1;
-			if (out_mask == 0)
-			{
-				out_mask = 0x80;
-				binary_seq++;
-				wdt_reset();
-			}
-			bits_remain--;
-		
-		}		
-		else    //rtty protocol
-		{
-			if( _txptr < 10 )
-			{
-				_radio_transmit_bit(_txbyte, _txptr);
-				_txptr++;
-			} else {
-				TIMSK0 &= ~(_BV(OCIE0A));
-				byte_complete = true;
-			}
-		} 
-        systicks = 0;
+        if( _radio_frame ) _radio_frame->state = RADIO_FRAME_FREE;
+        _radio_frame = NULL;
+
+        for(uint8_t i = 0; i < 2; i++)
+        {
+            if( radio_frames[i].state == RADIO_FRAME_READY )
+            {
+                _radio_start_frame(&radio_frames[i]);
+                _radio_send_symbol();
+                break;
+            }
+        }
     }
+
+    // The counter has already restarted, so this sets the next period
+    _radio_next_period();
 }
 
 /**
- * Interrupt handler for the DSP timer. Read out the next step
- * response value and write it to the DAC.
+ * Sample engine, the only user of the SPI and the only writer of the
+ * FINE DAC channel. Picks up the next symbol as soon as the symbol clock
+ * queues it, then asks the mapper for the mode for this sample. Nothing
+ * it calls is out of line, so it only saves the registers it uses; check
+ * the prologue in main.lss after changing it.
  */
 ISR(TIMER2_OVF_vect)
 {
+    uint16_t value;
+
+    if( _radio_sym_tail != _radio_sym_head )
+    {
+        uint8_t sym = _radio_sym[_radio_sym_tail];
+        _radio_sym_tail = (_radio_sym_tail + 1) & (RADIO_SYM_QUEUE_LEN - 1);
+
+        radio_mode = sym >> 4;
+        switch(radio_mode)
+        {
+            case RADIO_MODE_AFSK:
+                _radio_afsk_symbol(sym & 0x0F);
+                break;
+            default:
+                _radio_fsk_symbol(sym & 0x0F);
+                break;
+        }
+    }
 
-	if (radio_mode)
-	{
-		sin_phase += sin_phase_inc;
-		if ( sin_phase >= SIN_FULL_LEN)	//this only works as i know it wont overflow as sin_phase_inc is 3 or 4
-			sin_phase -= SIN_FULL_LEN;
-			
-		if ( sin_phase >= SIN_HALF_LEN)
-			_radio_dac_write(RADIO_FINE, (uint16_t)(255-(sin_table[sin_phase-SIN_HALF_LEN])) << 8);
-		else
-			_radio_dac_write(RADIO_FINE, ((uint16_t)sin_table[sin_phase]) << 8);
-	}
-	else
-	{
-		
-		if( sample < DSP_SAMPLES )
-		{
-			int32_t d = _transition_delta * (int32_t)(eeprom_read_byte(&step[sample]));
-			d /= 256;
-			d += (int32_t)_transition_start;
-			_radio_dac_write(RADIO_FINE, (uint16_t)d);
-			sample++;
-		} else {
-			TIMSK2 &= ~(_BV(TOIE2));
-			sample = 0;
-			transition_complete = true;
-		}
-	
-	}
-	
+    switch(radio_mode)
+    {
+        case RADIO_MODE_AFSK:
+            value = _radio_afsk_sample();
+            break;
+        default:
+            value = _radio_fsk_sample();
+            break;
+    }
+
+    // A queued command takes the SPI for this tick and FINE catches up
+    // on the next, so a retune always goes out with the FINE value it
+    // was given. Otherwise only touch the SPI when the output moves.
+    if( !dac_service() && value != _dac_value )
+    {
+        dac_send(DAC_LOAD_UPDATE(RADIO_FINE), value);
+        _dac_value = value;
+    }
 }
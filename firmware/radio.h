@@ -10,49 +10,112 @@
 #define __RADIO_H__
 
 #include <avr/io.h>
+#include "fec.h"
+#include "telemetry.h"
 
 #define RADIO_EN        2
 #define RADIO_EN_DDR    DDRC
 #define RADIO_EN_PORT   PORTC
 
-#define RADIO_PORT      PORTB
-#define RADIO_DDR       DDRB
-#define RADIO_MOSI      3
-#define RADIO_MISO      4
-#define RADIO_SCK       5
-#define RADIO_SS        2
-
 #define RADIO_DAC_A     0
 #define RADIO_DAC_B     1
 #define RADIO_FINE      RADIO_DAC_B
 #define RADIO_COARSE    RADIO_DAC_A
 
-#define RADIO_BAUD_50               156
-#define RADIO_BAUD_300              26
+// Symbols are clocked by TIMER1 counting at this rate, so the slowest
+// baud is the one whose symbol just fits in 16 bits. Faster than
+// RADIO_BAUD_MAX leaves the sample engine too few samples a symbol, and
+// the FSK modes stop lower still, see radio_baud_max().
+#define RADIO_SYMBOL_CLOCK          (F_CPU / 8)
+#define RADIO_BAUD_MIN              ((RADIO_SYMBOL_CLOCK + 65535) / 65536)
+#define RADIO_BAUD_MAX              2400
+
+#define RADIO_BAUD_50               50
+#define RADIO_BAUD_300              300
+#define RADIO_BAUD_600              600
+#define RADIO_BAUD_1200             1200
 #define RADIO_CENTER_FREQ_434630    0XA000
 #define RADIO_SHIFT_425             0x0A00
 
 
-#define DSP_SAMPLES     50
+// AFSK is generated by a phase accumulator clocked at the TIMER2 overflow
+// rate. These are the tones we have always used, RADIO_BELL202_* are the
+// standard 1200 baud AFSK pair.
+#define RADIO_SAMPLE_RATE           (F_CPU / 256)
+#define RADIO_DDS_INC(f)            ((uint16_t)(((uint32_t)(f) * 65536UL + \
+                                    RADIO_SAMPLE_RATE / 2) / RADIO_SAMPLE_RATE))
+#define RADIO_AFSK_MARK             1000
+#define RADIO_AFSK_SPACE            750
+#define RADIO_BELL202_MARK          1200
+#define RADIO_BELL202_SPACE         2200
+
 #define DSP_OFFSET      0
 
-void set_fsk(void);
-void set_afsk(void);
+// 4FSK and 8FSK send binary frames two and three bits a symbol, Gray
+// coded onto levels one shift apart. RTTY only ever uses the bottom two.
+#define RADIO_MODE_FSK      0
+#define RADIO_MODE_AFSK     1
+#define RADIO_MODE_4FSK     2
+#define RADIO_MODE_8FSK     3
+
+#define RADIO_FRAME_RTTY    0
+#define RADIO_FRAME_BINARY  1
+
+#define RADIO_FRAME_FREE    0
+#define RADIO_FRAME_READY   1
+#define RADIO_FRAME_ON_AIR  2
+
+// Sent at the start of every binary frame so the ground can find it, the
+// CCSDS attached sync marker
+#define RADIO_BINARY_SYNC   0x1ACFFC1DUL
+#define RADIO_SYNC_BYTES    4
+
+// A frame holds the sync word and the coded payload. An RTTY sentence
+// after its four byte preamble is shorter, radio.c checks.
+#define RADIO_RTTY_LEN      (4 + TELEMETRY_MAX_LEN)
+#define RADIO_FRAME_LEN     (RADIO_SYNC_BYTES + FEC_OUT_BYTES)
+
+// Symbols queued between the symbol clock and the sample engine, must be
+// a power of two
+#define RADIO_SYM_QUEUE_LEN 8
+
+/**
+ * One frame for the transmit queue
+ */
+typedef struct
+{
+    volatile uint8_t state;     // RADIO_FRAME_FREE/READY/ON_AIR
+    uint8_t type;               // RADIO_FRAME_RTTY or RADIO_FRAME_BINARY
+    uint8_t mode;               // RADIO_MODE_*
+    uint16_t baud;              // RADIO_BAUD_* or any in range
+    uint16_t bits;              // length of a binary frame
+    uint16_t sym_ticks;         // symbol clock counts a symbol, and the
+    uint16_t sym_frac;          // remainder in 1/baud counts, see submit
+    uint8_t data[RADIO_FRAME_LEN];
+} radio_frame_t;
+
 void radio_init(void);
 void radio_enable(void);
 void radio_disable(void);
-void _radio_dac_write(uint8_t channel, uint16_t value);
 void _radio_dac_off(void);
-void radio_transmit_sentence(char* string);
-void radio_transmit_string(char* string);
+void radio_tune(uint16_t coarse);
+radio_frame_t* radio_frame_get(void);
+bool radio_frame_reclaim(radio_frame_t* frame);
+void radio_frame_submit(radio_frame_t* frame);
+void _radio_start_frame(radio_frame_t* frame);
+bool _radio_send_symbol(void);
+bool _radio_next_char(void);
+uint8_t _radio_next_bits(uint8_t count);
+void _radio_format_trailer(char* buf, uint16_t crc);
 void _radio_transmit_bit(uint8_t data, uint8_t ptr);
+void _radio_set_tone(uint8_t high);
 uint16_t radio_calculate_checksum(char* data);
 void radio_set_shift(uint16_t shift);
-void radio_set_baud(uint8_t baud);
-void _radio_transition(uint16_t target);
+void radio_set_afsk_tones(uint16_t mark, uint16_t space);
+void radio_set_baud(uint16_t baud);
+uint16_t radio_baud_max(uint8_t mode);
+void _radio_next_period(void);
+bool _radio_push_symbol(uint8_t mode, uint8_t level);
 void radio_chatter(void);
-void radio_transmit_sentence_binary(uint8_t* string, uint16_t bits);
-void set_baud_50(void);
-void set_baud_300(void);
 
 #endif /* __RADIO_H__ */
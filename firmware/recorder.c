@@ -0,0 +1,181 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "recorder.h"
+#include "history.h"
+#include "nvm.h"
+
+#define RECORDER_DAY        86400UL
+
+// The log, oldest records overwritten first. make dump reads it back.
+recorder_t EEMEM recorder_log[RECORDER_LEN];
+
+// Records waiting for nvm_write() to take them, oldest first
+static recorder_t _recorder_stage[RECORDER_STAGE];
+static uint8_t _recorder_head = 0;
+static uint8_t _recorder_count = 0;
+
+// The last slot and sequence number given out
+static uint8_t _recorder_slot = RECORDER_LEN - 1;
+static uint8_t _recorder_seq = 0;
+
+// Where the next delta is from, as the ground will work it out, and how
+// many records since the last key. Starts out wanting a key.
+static int32_t _recorder_lat;
+static int32_t _recorder_lon;
+static uint32_t _recorder_time;
+static bool _recorder_started = false;
+static uint8_t _recorder_since_key = RECORDER_KEY_EVERY;
+
+static uint8_t _recorder_check(const recorder_t* r)
+{
+    uint8_t crc = RECORDER_SEED;
+
+    for(uint8_t i = 0; i < offsetof(recorder_fix_t, check); i++)
+        crc = _crc8_ccitt_update(crc, r->bytes[i]);
+    return crc;
+}
+
+bool _recorder_valid(const recorder_t* r)
+{
+    return r->fix.check == _recorder_check(r);
+}
+
+/**
+ * Carry on the log from its newest record, found the same way as in
+ * nvm_init(). Call once at start up, before the EEPROM is written.
+ */
+void recorder_init(void)
+{
+    recorder_t r, next;
+
+    eeprom_read_block(&next, &recorder_log[0], sizeof(recorder_t));
+    for(uint8_t i = 0; i < RECORDER_LEN; i++)
+    {
+        r = next;
+        eeprom_read_block(&next, &recorder_log[(i + 1) % RECORDER_LEN],
+                sizeof(recorder_t));
+
+        if( !_recorder_valid(&r) ) continue;
+        if( _recorder_valid(&next) &&
+                next.fix.seq == (uint8_t)(r.fix.seq + 1) )
+            continue;
+
+        _recorder_slot = i;
+        _recorder_seq = r.fix.seq;
+        break;
+    }
+}
+
+/**
+ * Give r the next slot, seal it and queue it. The caller has checked
+ * there is room.
+ */
+static void _recorder_push(recorder_t* r)
+{
+    _recorder_slot = (_recorder_slot + 1) % RECORDER_LEN;
+    r->fix.seq = ++_recorder_seq;
+    r->fix.check = _recorder_check(r);
+
+    _recorder_stage[(_recorder_head + _recorder_count) % RECORDER_STAGE] = *r;
+    _recorder_count++;
+}
+
+/**
+ * Log the fix in t if it is at least RECORDER_INTERVAL seconds newer
+ * than the last one logged. Call on every fix with a lock. This only
+ * queues it in RAM, recorder_flush() hands it to the EEPROM.
+ */
+void recorder_add(telemetry_t* t)
+{
+    uint32_t now = _history_time(t);
+    recorder_t r;
+
+    if( _recorder_started )
+    {
+        uint32_t age = (now + RECORDER_DAY - _recorder_time) % RECORDER_DAY;
+        if( age < RECORDER_INTERVAL ) return;
+    }
+
+    int32_t dlat = _history_steps(t->lat - _recorder_lat);
+    int32_t dlon = _history_steps(t->lon - _recorder_lon);
+    bool key = _recorder_since_key >= RECORDER_KEY_EVERY ||
+        dlat < INT16_MIN || dlat > INT16_MAX ||
+        dlon < INT16_MIN || dlon > INT16_MAX;
+
+    // Should the EEPROM fall behind this fix is lost, and so the next has
+    // to start from a key
+    if( RECORDER_STAGE - _recorder_count < (key ? 2 : 1) )
+    {
+        _recorder_since_key = RECORDER_KEY_EVERY;
+        return;
+    }
+
+    if( key )
+    {
+        memset(&r, 0, sizeof(r));
+        r.key.flags = RECORDER_KEY;
+        r.key.tick = t->tick;
+        r.key.lat = t->lat;
+        r.key.lon = t->lon;
+        _recorder_push(&r);
+
+        _recorder_lat = t->lat;
+        _recorder_lon = t->lon;
+        _recorder_since_key = 0;
+        dlat = 0;
+        dlon = 0;
+    }
+
+    int32_t alt = t->alt / 1000;
+    if( alt < 0 ) alt = 0;
+    if( alt > UINT16_MAX ) alt = UINT16_MAX;
+
+    r.fix.flags = (t->lock & RECORDER_LOCK) |
+        (now > UINT16_MAX ? RECORDER_TIME_HI : 0);
+    r.fix.tick = t->tick;
+    r.fix.time = now;
+    r.fix.alt = alt;
+    r.fix.dlat = dlat;
+    r.fix.dlon = dlon;
+    r.fix.temperature = t->temperature;
+    r.fix.sats = t->sats;
+    _recorder_push(&r);
+
+    _recorder_lat += dlat * HISTORY_STEP;
+    _recorder_lon += dlon * HISTORY_STEP;
+    _recorder_time = now;
+    _recorder_started = true;
+    _recorder_since_key++;
+}
+
+/**
+ * Hand the oldest queued record to nvm_write() if it is free. Call
+ * often, each record takes about 50ms of EEPROM writes.
+ */
+void recorder_flush(void)
+{
+    if( !_recorder_count ) return;
+
+    // The queue ends at the last slot given out
+    uint8_t slot = (_recorder_slot + RECORDER_LEN + 1 - _recorder_count)
+        % RECORDER_LEN;
+
+    if( nvm_write(&recorder_log[slot], &_recorder_stage[_recorder_head],
+                sizeof(recorder_t)) )
+    {
+        _recorder_head = (_recorder_head + 1) % RECORDER_STAGE;
+        _recorder_count--;
+    }
+}
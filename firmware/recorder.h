@@ -0,0 +1,86 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+// Records in the EEPROM log, and the least time in seconds between two
+// fixes going in. The log keeps the last 40 minutes or so, which covers
+// the descent, where fades lose most frames. With the schedule and the
+// counter ring it fills all but 26 bytes of the 1K EEPROM.
+// ground/recorder.c has to agree on the layout.
+#define RECORDER_LEN        48
+#define RECORDER_INTERVAL   60
+
+// A key record goes in at least this often, so the log can still be
+// decoded after the oldest records are overwritten
+#define RECORDER_KEY_EVERY  8
+
+// Records waiting in RAM for the EEPROM
+#define RECORDER_STAGE      4
+
+// Flags
+#define RECORDER_LOCK       0x07    // the GPS lock
+#define RECORDER_TIME_HI    0x40    // bit 16 of the time
+#define RECORDER_KEY        0x80    // a key record
+
+// Seed for the check byte, so that slots of the counter ring in nvm.c
+// never pass for records
+#define RECORDER_SEED       0x5A
+
+/**
+ * A fix, with its position as a delta from the one before, in steps of
+ * HISTORY_STEP. Closed loop, so errors do not build up.
+ */
+typedef struct
+{
+    uint8_t seq;            // one more than the record before
+    uint8_t flags;
+    uint16_t tick;
+    uint16_t time;          // seconds into the day, bit 16 in flags
+    uint16_t alt;           // m above MSL, 0 to 65535
+    int16_t dlat;
+    int16_t dlon;
+    int16_t temperature;    // raw TMP100 reading, 1/16 degC
+    uint8_t sats;
+    uint8_t check;          // CRC-8 of the above
+} recorder_fix_t;
+
+/**
+ * Where the deltas of the fixes after it start from. One goes before
+ * the first fix after start up, every RECORDER_KEY_EVERY records and
+ * whenever a delta would not fit.
+ */
+typedef struct
+{
+    uint8_t seq;
+    uint8_t flags;          // RECORDER_KEY
+    uint16_t tick;
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;
+    uint8_t reserved[3];
+    uint8_t check;
+} recorder_key_t;
+
+typedef union
+{
+    recorder_fix_t fix;
+    recorder_key_t key;
+    uint8_t bytes[16];
+} recorder_t;
+
+void recorder_init(void);
+void recorder_add(telemetry_t* t);
+void recorder_flush(void);
+bool _recorder_valid(const recorder_t* r);
+
+#endif /* __RECORDER_H__ */
@@ -0,0 +1,87 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include "radio.h"
+#include "schedule.h"
+
+// One RTTY beacon then one binary frame. Edit and "make eeprom" to
+// change the pattern without touching the flash.
+#define SCHEDULE_DEFAULT { \
+    .version = SCHEDULE_VERSION, \
+    .slots = 2, \
+    .pattern = { \
+        {RADIO_FRAME_RTTY, RADIO_MODE_AFSK, RADIO_BAUD_50}, \
+        {RADIO_FRAME_BINARY, RADIO_MODE_FSK, RADIO_BAUD_300}, \
+    }, \
+    .binary_above = 0, \
+}
+
+schedule_t EEMEM schedule_eeprom = SCHEDULE_DEFAULT;
+
+// Used when the EEPROM has been erased or holds nonsense
+static const schedule_t _schedule_default PROGMEM = SCHEDULE_DEFAULT;
+
+static schedule_t _schedule;
+static uint8_t _schedule_slot = 0;
+
+/**
+ * Check a pattern read from EEPROM is one we can send.
+ */
+bool _schedule_valid(const schedule_t* s)
+{
+    if( s->version != SCHEDULE_VERSION ) return false;
+    if( s->slots == 0 || s->slots > SCHEDULE_MAX_SLOTS ) return false;
+
+    for(uint8_t i = 0; i < s->slots; i++)
+    {
+        const schedule_slot_t* slot = &s->pattern[i];
+        if( slot->type > RADIO_FRAME_BINARY ) return false;
+        if( slot->mode > RADIO_MODE_8FSK ) return false;
+        if( slot->baud < RADIO_BAUD_MIN ||
+                slot->baud > radio_baud_max(slot->mode) )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Load the pattern from EEPROM, falling back to the built in one.
+ */
+void schedule_init(void)
+{
+    eeprom_read_block(&_schedule, &schedule_eeprom, sizeof(schedule_t));
+    if( !_schedule_valid(&_schedule) )
+        memcpy_P(&_schedule, &_schedule_default, sizeof(schedule_t));
+    _schedule_slot = 0;
+}
+
+/**
+ * Give the way to send the next frame. Above binary_above RTTY slots
+ * are passed over, unless there is nothing else in the pattern.
+ */
+void schedule_next(schedule_slot_t* slot, int32_t alt)
+{
+    bool high = _schedule.binary_above && alt > _schedule.binary_above;
+    uint8_t start = _schedule_slot;
+
+    do
+    {
+        *slot = _schedule.pattern[_schedule_slot];
+        if( ++_schedule_slot >= _schedule.slots ) _schedule_slot = 0;
+        if( !high || slot->type != RADIO_FRAME_RTTY ) return;
+    }
+    while( _schedule_slot != start );
+
+    // All RTTY, so carry on through it as if low
+    *slot = _schedule.pattern[_schedule_slot];
+    if( ++_schedule_slot >= _schedule.slots ) _schedule_slot = 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __SCHEDULE_H__
+#define __SCHEDULE_H__
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+// Longest pattern the EEPROM copy can hold
+#define SCHEDULE_MAX_SLOTS  8
+
+// Bumped whenever schedule_t changes so an old EEPROM image is ignored
+#define SCHEDULE_VERSION    2
+
+/**
+ * How to send one frame of the pattern
+ */
+typedef struct
+{
+    uint8_t type;           // RADIO_FRAME_RTTY or RADIO_FRAME_BINARY
+    uint8_t mode;           // RADIO_MODE_*
+    uint16_t baud;          // RADIO_BAUD_*, or any in range
+} schedule_slot_t;
+
+/**
+ * The pattern frames are sent in, repeated forever
+ */
+typedef struct
+{
+    uint8_t version;        // SCHEDULE_VERSION
+    uint8_t slots;          // entries of pattern[] in use
+    schedule_slot_t pattern[SCHEDULE_MAX_SLOTS];
+    int32_t binary_above;   // m, only binary slots above this, 0 for never
+} schedule_t;
+
+void schedule_init(void);
+void schedule_next(schedule_slot_t* slot, int32_t alt);
+bool _schedule_valid(const schedule_t* s);
+
+#endif /* __SCHEDULE_H__ */
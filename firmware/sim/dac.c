@@ -0,0 +1,135 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <string.h>
+#include <sim_avr.h>
+#include <sim_irq.h>
+#include <avr_spi.h>
+#include <avr_ioport.h>
+#include "dac.h"
+
+// SS for the DAC is PB2
+#define DAC_SS_PORT     'B'
+#define DAC_SS_PIN      2
+
+/**
+ * Apply a complete command to the model.
+ */
+static void _dac_command(dac_sink_t* dac)
+{
+    uint8_t cmd, ch;
+    uint16_t value;
+
+    if( dac->len == 3 )
+    {
+        cmd = dac->word[0] >> 4;
+        ch = dac->word[0] & 0x0F;
+        value = dac->word[1] << 8 | dac->word[2];
+    }
+    else if( dac->len == 2 )
+    {
+        // LTC1661, 10 data bits left adjusted to 16 here
+        uint16_t w = dac->word[0] << 8 | dac->word[1];
+        cmd = w >> 12;
+        value = ((w >> 2) & 0x3FF) << 6;
+        switch(cmd)
+        {
+            case 0x1: cmd = 0x0; ch = 0; break;
+            case 0x2: cmd = 0x0; ch = 1; break;
+            case 0x9: cmd = 0x3; ch = 0; break;
+            case 0xA: cmd = 0x3; ch = 1; break;
+            case 0xE: cmd = 0x4; ch = 0xF; break;
+            default:  dac->bad_words++; return;
+        }
+    }
+    else
+    {
+        dac->bad_words++;
+        return;
+    }
+
+    // Writes load the input register of one channel, or both for
+    // the all-DACs address
+    if( cmd == 0x0 || cmd == 0x2 || cmd == 0x3 )
+    {
+        if( ch > 1 ) dac->input[0] = dac->input[1] = value;
+        else dac->input[ch] = value;
+    }
+
+    switch(cmd)
+    {
+        // Write input register
+        case 0x0:
+            break;
+
+        // Update one, or write and update one
+        case 0x1:
+        case 0x3:
+            if( ch > 1 ) memcpy(dac->output, dac->input, sizeof(dac->output));
+            else dac->output[ch] = dac->input[ch];
+            dac->asleep = 0;
+            break;
+
+        // Write input, update all
+        case 0x2:
+            memcpy(dac->output, dac->input, sizeof(dac->output));
+            dac->asleep = 0;
+            break;
+
+        // Power down
+        case 0x4:
+            dac->asleep = 1;
+            break;
+
+        default:
+            dac->bad_words++;
+            return;
+    }
+    dac->words++;
+}
+
+static void _dac_spi_hook(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+    dac_sink_t* dac = (dac_sink_t*)param;
+
+    dac->bytes++;
+    if( dac->selected && dac->len < sizeof(dac->word) )
+        dac->word[dac->len++] = value;
+}
+
+static void _dac_ss_hook(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+    dac_sink_t* dac = (dac_sink_t*)param;
+
+    if( !value )
+    {
+        dac->selected = 1;
+        dac->len = 0;
+    }
+    else if( dac->selected )
+    {
+        dac->selected = 0;
+        _dac_command(dac);
+    }
+}
+
+/**
+ * Attach the sink to SPI and the SS pin of the AVR.
+ */
+void dac_sink_init(dac_sink_t* dac, avr_t* avr)
+{
+    memset(dac, 0, sizeof(*dac));
+    dac->avr = avr;
+    dac->asleep = 1;
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0),
+            SPI_IRQ_OUTPUT), _dac_spi_hook, dac);
+    avr_irq_register_notify(avr_io_getirq(avr,
+            AVR_IOCTL_IOPORT_GETIRQ(DAC_SS_PORT), DAC_SS_PIN),
+            _dac_ss_hook, dac);
+}
@@ -0,0 +1,39 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __SIM_DAC_H__
+#define __SIM_DAC_H__
+
+#include <stdint.h>
+#include <sim_avr.h>
+#include <sim_irq.h>
+
+/**
+ * Sink for the SPI DAC. Bytes are collected between SS going low and
+ * high again and decoded as one LTC2602 style command, or LTC1661 if
+ * the word is two bytes.
+ */
+typedef struct
+{
+    avr_t* avr;
+    uint8_t word[4];
+    uint8_t len;
+    uint8_t selected;
+
+    uint16_t input[2];      // loaded but not yet on the outputs
+    uint16_t output[2];     // what the outputs are driving
+    uint8_t asleep;
+
+    uint32_t bytes;
+    uint32_t words;
+    uint32_t bad_words;     // wrong length or unknown command
+} dac_sink_t;
+
+void dac_sink_init(dac_sink_t* dac, avr_t* avr);
+
+#endif /* __SIM_DAC_H__ */
@@ -0,0 +1,414 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Run main.elf under simavr with a GPS, a TMP100 and the DAC attached,
+ * and report how the CPU time is spent. Usage:
+ *
+ *     profile [-s seconds] [-t track.csv] [-x speed] main.elf main.sym
+ *
+ * With -t the GPS replays a recorded flight, speed times faster than
+ * real time, and by default the run lasts for the whole flight.
+ *
+ * main.sym is the output of avr-nm, used to find the main loop and the
+ * task table. A pass of the main loop starts each time task_run() is
+ * entered, and counts as idle if it neither parsed a GPS byte nor
+ * submitted a frame. At the end the firmware's own task stats are read
+ * out of its RAM.
+ *
+ * For each interrupt it reports the cycles spent in it, the worst time
+ * from the flag being raised to the ISR starting, and overruns: runs
+ * that started at least the shortest period between raises late, where
+ * a raise has been lost. Any overruns of TIMER2_OVF mean dropped
+ * samples.
+ *
+ * Experimental: this has only been compiled against stand-ins for
+ * simavr's headers, never built and run against the library. Compare
+ * its numbers with a scope on the real board before relying on them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_irq.h>
+#include <sim_interrupts.h>
+#include "ubx.h"
+#include "tmp100.h"
+#include "dac.h"
+#include "track.h"
+
+#define SIM_MCU         "atmega328p"
+#define SIM_F_CPU       16000000
+#define SIM_GPS_BAUD    38400
+#define SIM_TMP100_ADDR 0x96
+#define SIM_VECTORS     26
+
+// Data symbols from avr-nm are offset into their own address space
+#define SIM_DATA_OFFSET 0x800000
+
+// Sizes of task_t and task_stat_t on the AVR, which packs structs, and
+// the counts of TIMER0 the stats are kept in
+#define SIM_TASK_SIZE       6
+#define SIM_TASK_STAT_SIZE  14
+#define SIM_TASK_CYCLES     64
+
+// Names of the ATmega328P vectors, by number
+static const char* vector_names[SIM_VECTORS] = {
+    "RESET", "INT0", "INT1", "PCINT0", "PCINT1", "PCINT2", "WDT",
+    "TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF", "TIMER1_CAPT",
+    "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA",
+    "TIMER0_COMPB", "TIMER0_OVF", "SPI_STC", "USART_RX", "USART_UDRE",
+    "USART_TX", "ADC", "EE_READY", "ANALOG_COMP", "TWI", "SPM_READY"
+};
+
+/**
+ * What we know about one interrupt vector
+ */
+typedef struct
+{
+    uint64_t pending_at;    // cycle the flag was raised, 0 if not pending
+    uint64_t started_at;
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t max_cycles;
+    uint64_t max_latency;
+    uint64_t raised_at;     // cycle the flag was last raised
+    uint64_t min_period;    // shortest time between two raises
+    uint64_t overruns;      // runs that started a whole period late
+} isr_stat_t;
+
+static avr_t* avr;
+static isr_stat_t isr_stats[SIM_VECTORS];
+static uint64_t isr_total;
+static int profiling;
+
+/**
+ * Look up a symbol in avr-nm output, returning its byte address or 0.
+ */
+static uint32_t sym_lookup(const char* path, const char* name)
+{
+    FILE* f = fopen(path, "r");
+    char line[256], sym[200];
+    unsigned int addr;
+    char type;
+    uint32_t found = 0;
+
+    if( !f )
+    {
+        perror(path);
+        exit(1);
+    }
+    while( fgets(line, sizeof(line), f) )
+    {
+        if( sscanf(line, "%x %c %199s", &addr, &type, sym) == 3 &&
+                strcmp(sym, name) == 0 )
+        {
+            found = addr;
+            break;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static void isr_pending_hook(struct avr_irq_t* irq, uint32_t value,
+        void* param)
+{
+    isr_stat_t* s = (isr_stat_t*)param;
+
+    if( value && !s->pending_at )
+    {
+        if( profiling && s->raised_at &&
+                (!s->min_period || avr->cycle - s->raised_at < s->min_period) )
+            s->min_period = avr->cycle - s->raised_at;
+        s->raised_at = avr->cycle;
+        s->pending_at = avr->cycle;
+    }
+}
+
+static void isr_running_hook(struct avr_irq_t* irq, uint32_t value,
+        void* param)
+{
+    isr_stat_t* s = (isr_stat_t*)param;
+
+    if( value )
+    {
+        if( profiling && s->pending_at )
+        {
+            uint64_t latency = avr->cycle - s->pending_at;
+            if( latency > s->max_latency ) s->max_latency = latency;
+
+            // simavr drops a raise while the flag is still set, so this
+            // run has swallowed at least one, a lost timer overflow say
+            if( s->min_period && latency >= s->min_period ) s->overruns++;
+        }
+        s->pending_at = 0;
+        s->started_at = avr->cycle;
+    }
+    else if( s->started_at )
+    {
+        uint64_t c = avr->cycle - s->started_at;
+        if( profiling )
+        {
+            s->count++;
+            s->cycles += c;
+            isr_total += c;
+            if( c > s->max_cycles ) s->max_cycles = c;
+        }
+        s->started_at = 0;
+    }
+}
+
+static uint32_t sim_read(uint32_t addr, int bytes)
+{
+    uint32_t v = 0;
+    for(int i = bytes - 1; i >= 0; i--)
+        v = v << 8 | avr->data[addr + i];
+    return v;
+}
+
+/**
+ * Print the run counts and timings the scheduler keeps for each task,
+ * following the pointers task_init() was given.
+ */
+static void print_tasks(const char* sym_path)
+{
+    uint32_t table_sym = sym_lookup(sym_path, "task_table");
+    uint32_t stats_sym = sym_lookup(sym_path, "task_stats");
+    uint32_t count_sym = sym_lookup(sym_path, "task_count");
+    if( !table_sym || !stats_sym || !count_sym ) return;
+
+    uint32_t table = sim_read(table_sym - SIM_DATA_OFFSET, 2);
+    uint32_t stats = sim_read(stats_sym - SIM_DATA_OFFSET, 2);
+    uint8_t count = sim_read(count_sym - SIM_DATA_OFFSET, 1);
+
+    printf("%-14s %10s %9s %9s %7s\n", "task", "runs", "avg cyc",
+            "max cyc", "misses");
+    for(uint8_t i = 0; i < count; i++)
+    {
+        uint32_t t = table + i * SIM_TASK_SIZE;
+        uint32_t st = stats + i * SIM_TASK_STAT_SIZE;
+        char name[16];
+        uint32_t p = sim_read(t, 2);
+        int n = 0;
+        while( n < (int)sizeof(name) - 1 && avr->data[p + n] )
+        {
+            name[n] = avr->data[p + n];
+            n++;
+        }
+        name[n] = '\0';
+
+        uint32_t runs = sim_read(st, 4);
+        uint32_t time = sim_read(st + 4, 4);
+        printf("%-14s %10u %9.1f %9u %7u\n", name, runs,
+                runs ? (double)time * SIM_TASK_CYCLES / runs : 0.0,
+                sim_read(st + 8, 2) * SIM_TASK_CYCLES, sim_read(st + 10, 2));
+    }
+    printf("\n");
+}
+
+static double cycles_to_us(uint64_t cycles)
+{
+    return cycles * 1e6 / avr->frequency;
+}
+
+int main(int argc, char** argv)
+{
+    elf_firmware_t f;
+    ubx_t ubx;
+    tmp100_t tmp;
+    dac_sink_t dac;
+    track_t track;
+    const char* track_path = NULL;
+    uint32_t speed = 1;
+    double seconds = 0;
+    int opt;
+
+    while( (opt = getopt(argc, argv, "s:t:x:")) != -1 )
+    {
+        switch(opt)
+        {
+            case 's': seconds = atof(optarg); break;
+            case 't': track_path = optarg; break;
+            case 'x': speed = atoi(optarg); break;
+            default: argc = 0; break;
+        }
+    }
+    if( argc - optind != 2 )
+    {
+        fprintf(stderr, "usage: %s [-s seconds] [-t track.csv] [-x speed] "
+                "main.elf main.sym\n", argv[0]);
+        return 1;
+    }
+    const char* elf_path = argv[optind];
+    const char* sym_path = argv[optind + 1];
+
+    if( track_path )
+    {
+        if( track_load(&track, track_path) < 2 )
+        {
+            fprintf(stderr, "no track in %s\n", track_path);
+            return 1;
+        }
+        if( speed < 1 ) speed = 1;
+        if( !seconds ) seconds = track_duration(&track) / speed + 1;
+    }
+    if( !seconds ) seconds = 30.0;
+
+    uint32_t loop_pc = sym_lookup(sym_path, "task_run");
+    uint32_t work_pc[2] = {
+        sym_lookup(sym_path, "_gps_parse_byte"),
+        sym_lookup(sym_path, "radio_frame_submit")
+    };
+    if( !loop_pc )
+    {
+        fprintf(stderr, "task_run not found in %s\n", sym_path);
+        return 1;
+    }
+
+    memset(&f, 0, sizeof(f));
+    if( elf_read_firmware(elf_path, &f) != 0 )
+    {
+        fprintf(stderr, "cannot load %s\n", elf_path);
+        return 1;
+    }
+    strcpy(f.mmcu, SIM_MCU);
+    f.frequency = SIM_F_CPU;
+
+    avr = avr_make_mcu_by_name(f.mmcu);
+    if( !avr )
+    {
+        fprintf(stderr, "simavr has no %s\n", f.mmcu);
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &f);
+    avr->frequency = SIM_F_CPU;
+
+    ubx_init(&ubx, avr, SIM_GPS_BAUD);
+    tmp100_init(&tmp, avr, SIM_TMP100_ADDR);
+    dac_sink_init(&dac, avr);
+    if( track_path ) track_attach(&track, &ubx, speed);
+
+    for(int v = 1; v < SIM_VECTORS; v++)
+    {
+        avr_irq_t* irq = avr_get_interrupt_irq(avr, v);
+        if( !irq ) continue;
+        avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING,
+                isr_pending_hook, &isr_stats[v]);
+        avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING,
+                isr_running_hook, &isr_stats[v]);
+    }
+
+    // Main loop passes, timed from one entry of task_run() to the next
+    uint64_t passes = 0, idle_passes = 0, idle_cycles = 0;
+    uint64_t pass_start = 0, pass_isr = 0;
+    uint64_t period_min = UINT64_MAX, period_max = 0;
+    uint64_t profile_start = 0, end = 0, frames = 0;
+    int pass_work = 0;
+
+    while( 1 )
+    {
+        int state = avr_run(avr);
+        if( state == cpu_Done || state == cpu_Crashed )
+        {
+            fprintf(stderr, "cpu stopped at pc 0x%04x after %llu cycles\n",
+                    (unsigned int)avr->pc, (unsigned long long)avr->cycle);
+            break;
+        }
+
+        if( avr->pc == work_pc[0] || avr->pc == work_pc[1] )
+        {
+            pass_work = 1;
+            if( profiling && avr->pc == work_pc[1] ) frames++;
+        }
+
+        if( avr->pc == loop_pc )
+        {
+            if( !profiling )
+            {
+                // Start counting from the first pass, after start up
+                profiling = 1;
+                profile_start = avr->cycle;
+                end = profile_start + (uint64_t)(seconds * avr->frequency);
+            }
+            else
+            {
+                uint64_t period = avr->cycle - pass_start;
+                passes++;
+                if( period < period_min ) period_min = period;
+                if( period > period_max ) period_max = period;
+                if( !pass_work )
+                {
+                    idle_passes++;
+                    idle_cycles += period - (isr_total - pass_isr);
+                }
+            }
+            pass_start = avr->cycle;
+            pass_isr = isr_total;
+            pass_work = 0;
+        }
+
+        if( profiling && avr->cycle >= end ) break;
+    }
+
+    if( !profiling )
+    {
+        fprintf(stderr, "main loop never reached\n");
+        return 1;
+    }
+
+    uint64_t total = avr->cycle - profile_start;
+    printf("%.3f s simulated, %llu cycles from the first pass of main()\n\n",
+            total / (double)avr->frequency, (unsigned long long)total);
+
+    printf("%-14s %10s %9s %9s %11s %9s %7s\n", "vector", "count",
+            "avg cyc", "max cyc", "max lat us", "overruns", "cpu %");
+    for(int v = 1; v < SIM_VECTORS; v++)
+    {
+        isr_stat_t* s = &isr_stats[v];
+        if( !s->count ) continue;
+        printf("%-14s %10llu %9.1f %9llu %11.2f %9llu %7.2f\n",
+                vector_names[v], (unsigned long long)s->count,
+                (double)s->cycles / s->count,
+                (unsigned long long)s->max_cycles,
+                cycles_to_us(s->max_latency),
+                (unsigned long long)s->overruns, 100.0 * s->cycles / total);
+    }
+    printf("%-14s %10s %9s %9s %11s %9s %7.2f\n\n", "all", "", "", "", "",
+            "", 100.0 * isr_total / total);
+
+    if( passes )
+    {
+        printf("main loop      %llu passes, period min %.1f us, "
+                "avg %.1f us, max %.1f us\n", (unsigned long long)passes,
+                cycles_to_us(period_min),
+                cycles_to_us((pass_start - profile_start) / passes),
+                cycles_to_us(period_max));
+        printf("idle           %.1f %% of passes, %.1f %% of cpu\n\n",
+                100.0 * idle_passes / passes, 100.0 * idle_cycles / total);
+    }
+
+    print_tasks(sym_path);
+
+    printf("frames         %llu submitted\n", (unsigned long long)frames);
+    printf("gps            %u epochs, %u config messages\n", ubx.epochs,
+            ubx.configs);
+    if( track_path )
+        printf("track          %u epochs at %ux, %u without a fix\n",
+                track.epochs, speed, track.lost);
+    printf("tmp100         %u bytes read, %u written\n", tmp.reads,
+            tmp.writes);
+    printf("dac            %u words, %u bad, %u spi bytes\n", dac.words,
+            dac.bad_words, dac.bytes);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <string.h>
+#include <sim_avr.h>
+#include <sim_irq.h>
+#include <avr_twi.h>
+#include "tmp100.h"
+
+/**
+ * Follow the bus conditions raised by the TWI peripheral and answer
+ * those addressed to us, after the i2c_eeprom part in simavr.
+ */
+static void _tmp100_hook(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+    tmp100_t* tmp = (tmp100_t*)param;
+    avr_twi_msg_irq_t v;
+    v.u.v = value;
+
+    if( v.u.twi.msg & TWI_COND_STOP )
+        tmp->selected = 0;
+
+    if( v.u.twi.msg & TWI_COND_START )
+    {
+        tmp->selected = 0;
+        tmp->index = 0;
+        if( (v.u.twi.addr & 0xFE) == tmp->addr )
+        {
+            tmp->selected = v.u.twi.addr;
+            avr_raise_irq(tmp->in,
+                    avr_twi_irq_msg(TWI_COND_ACK, tmp->selected, 1));
+        }
+    }
+
+    if( !tmp->selected ) return;
+
+    // First byte written sets the pointer, the rest go into the register
+    if( v.u.twi.msg & TWI_COND_WRITE )
+    {
+        avr_raise_irq(tmp->in,
+                avr_twi_irq_msg(TWI_COND_ACK, tmp->selected, 1));
+        if( tmp->index == 0 )
+        {
+            tmp->ptr = v.u.twi.data & 0x03;
+        }
+        else if( tmp->ptr != 0 )
+        {
+            if( tmp->index == 1 )
+                tmp->reg[tmp->ptr] = (tmp->reg[tmp->ptr] & 0x00FF) |
+                    v.u.twi.data << 8;
+            else
+                tmp->reg[tmp->ptr] = (tmp->reg[tmp->ptr] & 0xFF00) |
+                    v.u.twi.data;
+        }
+        tmp->index++;
+        tmp->writes++;
+    }
+
+    if( v.u.twi.msg & TWI_COND_READ )
+    {
+        uint16_t r = tmp->reg[tmp->ptr];
+        uint8_t data = tmp->index & 1 ? r & 0xFF : r >> 8;
+
+        // The config register is a single byte, it just repeats
+        if( tmp->ptr == 1 ) data = r >> 8;
+
+        avr_raise_irq(tmp->in,
+                avr_twi_irq_msg(TWI_COND_READ, tmp->selected, data));
+        tmp->index++;
+        tmp->reads++;
+    }
+}
+
+/**
+ * Attach a TMP100 at the given 8 bit address, reading 20degC.
+ */
+void tmp100_init(tmp100_t* tmp, avr_t* avr, uint8_t addr)
+{
+    memset(tmp, 0, sizeof(*tmp));
+    tmp->addr = addr & 0xFE;
+    tmp->in = avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT);
+    tmp->reg[2] = 75 << 8;
+    tmp->reg[3] = 80 << 8;
+    tmp100_set_temperature(tmp, 20.0);
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0),
+            TWI_IRQ_OUTPUT), _tmp100_hook, tmp);
+}
+
+/**
+ * Set the temperature register, left adjusted in 1/16 degC steps.
+ */
+void tmp100_set_temperature(tmp100_t* tmp, float degc)
+{
+    int16_t raw = (int16_t)(degc * 16.0f);
+    tmp->reg[0] = (uint16_t)(raw << 4);
+}
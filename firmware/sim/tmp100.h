@@ -0,0 +1,36 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __SIM_TMP100_H__
+#define __SIM_TMP100_H__
+
+#include <stdint.h>
+#include <sim_avr.h>
+#include <sim_irq.h>
+
+/**
+ * A TMP100 on the TWI bus. Temperature, config and the two limit
+ * registers behind a pointer register, reads return MSB first.
+ */
+typedef struct
+{
+    avr_irq_t* in;          // TWI input, towards the AVR
+    uint8_t addr;           // 8 bit address with R/W clear
+    uint8_t selected;
+    uint8_t ptr;
+    uint8_t index;          // bytes into the current transfer
+    uint16_t reg[4];
+
+    uint32_t reads;
+    uint32_t writes;
+} tmp100_t;
+
+void tmp100_init(tmp100_t* tmp, avr_t* avr, uint8_t addr);
+void tmp100_set_temperature(tmp100_t* tmp, float degc);
+
+#endif /* __SIM_TMP100_H__ */
@@ -0,0 +1,192 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "track.h"
+
+/**
+ * Parse a decimal number of degrees into 1e-7 degrees without going
+ * through a float, so positions survive the round trip exactly.
+ */
+static int32_t _track_degrees(const char* s)
+{
+    int neg = 0;
+    int64_t v = 0;
+    int places = -1;
+
+    while( *s == ' ' ) s++;
+    if( *s == '-' )
+    {
+        neg = 1;
+        s++;
+    }
+    for( ; *s && *s != ',' && *s != '\n' && *s != '\r'; s++ )
+    {
+        if( *s == '.' )
+        {
+            places = 0;
+            continue;
+        }
+        if( *s < '0' || *s > '9' ) break;
+        if( places >= 7 ) continue;
+        v = v * 10 + (*s - '0');
+        if( places >= 0 ) places++;
+    }
+    if( places < 0 ) places = 0;
+    while( places++ < 7 ) v *= 10;
+    return neg ? -v : v;
+}
+
+/**
+ * Load a track from a CSV with a HH:MM:SS time followed by latitude,
+ * longitude and altitude in metres, like misc/nova21/telemetry.csv.
+ * Anything before the time, such as a sentence count, is ignored, as
+ * are lines without a time. Returns the number of points.
+ */
+int track_load(track_t* track, const char* path)
+{
+    FILE* f = fopen(path, "r");
+    char line[256];
+    uint32_t size = 0;
+
+    memset(track, 0, sizeof(*track));
+    if( !f ) return -1;
+
+    while( fgets(line, sizeof(line), f) )
+    {
+        char* time = NULL;
+        char* field[3];
+        int n = 0;
+        unsigned int h, m, s;
+
+        // Find the time field, then take the three after it
+        for( char* tok = line; tok; )
+        {
+            if( !time )
+            {
+                if( sscanf(tok, "%u:%u:%u", &h, &m, &s) == 3 ) time = tok;
+            }
+            else if( n < 3 )
+                field[n++] = tok;
+
+            tok = strchr(tok, ',');
+            if( tok ) tok++;
+        }
+        if( !time || n < 3 ) continue;
+
+        if( track->count == size )
+        {
+            size = size ? size * 2 : 256;
+            track->points = realloc(track->points,
+                    size * sizeof(track_point_t));
+        }
+
+        track_point_t* pt = &track->points[track->count];
+        pt->t = h * 3600 + m * 60 + s;
+        pt->lat = _track_degrees(field[0]);
+        pt->lon = _track_degrees(field[1]);
+        pt->alt = (int32_t)(atof(field[2]) * 1000.0);
+
+        // Drop anything that goes back in time
+        if( track->count && pt->t <= track->points[track->count - 1].t )
+            continue;
+        track->count++;
+    }
+    fclose(f);
+    return track->count;
+}
+
+/**
+ * Length of the track in seconds of track time.
+ */
+uint32_t track_duration(track_t* track)
+{
+    if( track->count < 2 ) return 0;
+    return track->points[track->count - 1].t - track->points[0].t;
+}
+
+/**
+ * Work out the fix at the current track time. Between two close points
+ * the position is interpolated, across a long gap there is no fix, and
+ * after the last point we sit on the ground where it landed.
+ */
+static void _track_fix(track_t* track, ubx_fix_t* fix)
+{
+    while( track->next < track->count &&
+            track->points[track->next].t < track->t )
+        track->next++;
+
+    if( track->next >= track->count )
+    {
+        track_point_t* last = &track->points[track->count - 1];
+        fix->lat = last->lat;
+        fix->lon = last->lon;
+        fix->alt = last->alt;
+        fix->lock = 3;
+        fix->sats = 8;
+        return;
+    }
+
+    track_point_t* b = &track->points[track->next];
+    if( b->t == track->t || track->next == 0 )
+    {
+        fix->lat = b->lat;
+        fix->lon = b->lon;
+        fix->alt = b->alt;
+        fix->lock = 3;
+        fix->sats = 8;
+        return;
+    }
+
+    track_point_t* a = b - 1;
+    uint32_t span = b->t - a->t;
+    if( span > TRACK_MAX_GAP )
+    {
+        // Keep reporting the last position, as the receiver would
+        fix->lock = 0;
+        fix->sats = 2;
+        track->lost++;
+        return;
+    }
+
+    int64_t k = track->t - a->t;
+    fix->lat = a->lat + (int64_t)(b->lat - a->lat) * k / span;
+    fix->lon = a->lon + (int64_t)(b->lon - a->lon) * k / span;
+    fix->alt = a->alt + (int64_t)(b->alt - a->alt) * k / span;
+    fix->lock = 3;
+    fix->sats = 8;
+}
+
+/**
+ * Called by the GPS model at each epoch, which comes once a second of
+ * simulated time and moves the track on by speed seconds.
+ */
+static void _track_epoch(ubx_t* ubx, void* param)
+{
+    track_t* track = (track_t*)param;
+
+    _track_fix(track, &ubx->fix);
+    ubx->itow = track->t * 1000UL;
+    track->t += track->speed;
+    track->epochs++;
+}
+
+/**
+ * Have the GPS model replay the track from its first point, running
+ * speed times faster than real time.
+ */
+void track_attach(track_t* track, ubx_t* ubx, uint32_t speed)
+{
+    track->speed = speed ? speed : 1;
+    track->t = track->points[0].t;
+    track->next = 0;
+    ubx->epoch = _track_epoch;
+    ubx->epoch_param = track;
+}
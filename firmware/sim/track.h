@@ -0,0 +1,50 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __SIM_TRACK_H__
+#define __SIM_TRACK_H__
+
+#include <stdint.h>
+#include "ubx.h"
+
+// Points further apart than this in seconds are a loss of fix rather
+// than something to interpolate across
+#define TRACK_MAX_GAP       120
+
+/**
+ * One point of a recorded flight
+ */
+typedef struct
+{
+    uint32_t t;             // seconds since midnight UTC
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;            // 1e-7 degrees
+    int32_t alt;            // mm
+} track_point_t;
+
+/**
+ * A flight to replay through the GPS model, speed times faster than
+ * real time.
+ */
+typedef struct
+{
+    track_point_t* points;
+    uint32_t count;
+    uint32_t speed;
+    uint32_t t;             // track time of the next epoch
+    uint32_t next;          // first point at or after t
+
+    uint32_t epochs;
+    uint32_t lost;          // epochs sent without a fix
+} track_t;
+
+int track_load(track_t* track, const char* path);
+uint32_t track_duration(track_t* track);
+void track_attach(track_t* track, ubx_t* ubx, uint32_t speed);
+
+#endif /* __SIM_TRACK_H__ */
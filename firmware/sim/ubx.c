@@ -0,0 +1,223 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <string.h>
+#include <sim_avr.h>
+#include <sim_irq.h>
+#include <sim_time.h>
+#include <sim_cycle_timers.h>
+#include <avr_uart.h>
+#include "ubx.h"
+
+/**
+ * Write v little endian at p.
+ */
+static void _ubx_le32(uint8_t* p, uint32_t v)
+{
+    for(int i = 0; i < 4; i++)
+        p[i] = v >> (8 * i);
+}
+
+/**
+ * Queue a UBX message to go to the AVR, framed and checksummed. Anything
+ * that does not fit is dropped, as the real receiver would.
+ */
+void ubx_send(ubx_t* ubx, uint8_t cls, uint8_t id, uint8_t* payload,
+        uint16_t len)
+{
+    uint8_t frame[6 + 256 + 2];
+    uint8_t a = 0, b = 0;
+
+    if( len > 256 ) return;
+
+    frame[0] = 0xB5;
+    frame[1] = 0x62;
+    frame[2] = cls;
+    frame[3] = id;
+    frame[4] = len & 0xFF;
+    frame[5] = len >> 8;
+    memcpy(&frame[6], payload, len);
+    for(uint16_t i = 2; i < len + 6; i++)
+    {
+        a += frame[i];
+        b += a;
+    }
+    frame[len + 6] = a;
+    frame[len + 7] = b;
+
+    for(uint16_t i = 0; i < len + 8; i++)
+    {
+        uint16_t next = (ubx->tx_head + 1) % UBX_TX_BUF_LEN;
+        if( next == ubx->tx_tail ) return;
+        ubx->tx[ubx->tx_head] = frame[i];
+        ubx->tx_head = next;
+    }
+}
+
+/**
+ * Acknowledge a configuration message.
+ */
+static void _ubx_ack(ubx_t* ubx, uint8_t cls, uint8_t id)
+{
+    uint8_t payload[2] = {cls, id};
+    ubx_send(ubx, 0x05, 0x01, payload, 2);
+    ubx->configs++;
+}
+
+/**
+ * Act on a complete message from the AVR: class, id, length, payload.
+ */
+static void _ubx_handle(ubx_t* ubx)
+{
+    uint8_t cls = ubx->msg[0];
+    uint8_t id = ubx->msg[1];
+    uint16_t len = ubx->msg[2] | ubx->msg[3] << 8;
+
+    if( cls != 0x06 ) return;
+
+    // CFG-NAV5, answer a poll or take the new dynamic model
+    if( id == 0x24 )
+    {
+        if( len == 0 )
+        {
+            uint8_t nav5[36] = {0xFF, 0xFF, ubx->dyn_model, 3};
+            ubx_send(ubx, 0x06, 0x24, nav5, sizeof(nav5));
+        }
+        else
+        {
+            ubx->dyn_model = ubx->msg[4 + 2];
+        }
+    }
+    _ubx_ack(ubx, cls, id);
+}
+
+/**
+ * Each byte the AVR sends goes through a UBX parser, NMEA is ignored.
+ */
+static void _ubx_out_hook(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+    ubx_t* ubx = (ubx_t*)param;
+    uint8_t b = value;
+
+    // msg_len counts the sync bytes so 0 and 1 mean hunting for sync
+    if( ubx->msg_len == 0 )
+    {
+        if( b == 0xB5 ) ubx->msg_len = 1;
+        return;
+    }
+    if( ubx->msg_len == 1 )
+    {
+        ubx->msg_len = b == 0x62 ? 2 : 0;
+        return;
+    }
+
+    ubx->msg[ubx->msg_len - 2] = b;
+    ubx->msg_len++;
+
+    uint16_t have = ubx->msg_len - 2;
+    if( have >= 4 )
+    {
+        uint16_t len = ubx->msg[2] | ubx->msg[3] << 8;
+        if( len + 6u > sizeof(ubx->msg) )
+            ubx->msg_len = 0;
+        else if( have == len + 6 )
+        {
+            _ubx_handle(ubx);
+            ubx->msg_len = 0;
+        }
+    }
+}
+
+/**
+ * Clock the next queued byte into the USART at the line rate.
+ */
+static avr_cycle_count_t _ubx_byte_timer(avr_t* avr, avr_cycle_count_t when,
+        void* param)
+{
+    ubx_t* ubx = (ubx_t*)param;
+
+    if( ubx->tx_tail != ubx->tx_head )
+    {
+        avr_raise_irq(ubx->rx, ubx->tx[ubx->tx_tail]);
+        ubx->tx_tail = (ubx->tx_tail + 1) % UBX_TX_BUF_LEN;
+    }
+    return when + ubx->byte_cycles;
+}
+
+/**
+ * Push the navigation solution for this epoch and move on a second.
+ */
+static avr_cycle_count_t _ubx_epoch_timer(avr_t* avr, avr_cycle_count_t when,
+        void* param)
+{
+    ubx_t* ubx = (ubx_t*)param;
+    ubx_fix_t* fix = &ubx->fix;
+
+    if( ubx->epoch ) ubx->epoch(ubx, ubx->epoch_param);
+    uint32_t tod = (ubx->itow / 1000) % 86400;
+
+    uint8_t sol[52] = {0};
+    _ubx_le32(sol, ubx->itow);
+    sol[10] = fix->lock;
+    sol[11] = fix->lock ? 0x0D : 0x00;
+    sol[47] = fix->sats;
+    ubx_send(ubx, 0x01, 0x06, sol, sizeof(sol));
+
+    uint8_t posllh[28] = {0};
+    _ubx_le32(posllh, ubx->itow);
+    _ubx_le32(&posllh[4], fix->lon);
+    _ubx_le32(&posllh[8], fix->lat);
+    _ubx_le32(&posllh[12], fix->alt);
+    _ubx_le32(&posllh[16], fix->alt);
+    ubx_send(ubx, 0x01, 0x02, posllh, sizeof(posllh));
+
+    uint8_t timeutc[20] = {0};
+    _ubx_le32(timeutc, ubx->itow);
+    timeutc[16] = tod / 3600;
+    timeutc[17] = (tod / 60) % 60;
+    timeutc[18] = tod % 60;
+    timeutc[19] = fix->lock ? 0x07 : 0x00;
+    ubx_send(ubx, 0x01, 0x21, timeutc, sizeof(timeutc));
+
+    // A replay sets iTOW itself, otherwise a second goes by
+    if( !ubx->epoch ) ubx->itow += 1000;
+    ubx->epochs++;
+    return when + avr_usec_to_cycles(avr, 1000000);
+}
+
+/**
+ * Attach the model to USART0 of the AVR. It starts with a 3D fix over
+ * Cambridge at 12:00:00 UTC, change ubx->fix to move it.
+ */
+void ubx_init(ubx_t* ubx, avr_t* avr, uint32_t baud)
+{
+    memset(ubx, 0, sizeof(*ubx));
+    ubx->avr = avr;
+    ubx->rx = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'),
+            UART_IRQ_INPUT);
+    ubx->byte_cycles = avr->frequency * 10 / baud;
+    ubx->itow = 12 * 3600 * 1000UL;
+
+    ubx->fix.lat = 522049312;
+    ubx->fix.lon = 1208511;
+    ubx->fix.alt = 12000;
+    ubx->fix.lock = 3;
+    ubx->fix.sats = 8;
+
+    // Keep the AVR's output off our stdout
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'),
+            UART_IRQ_OUTPUT), _ubx_out_hook, ubx);
+
+    avr_cycle_timer_register(avr, ubx->byte_cycles, _ubx_byte_timer, ubx);
+    avr_cycle_timer_register_usec(avr, 500000, _ubx_epoch_timer, ubx);
+}
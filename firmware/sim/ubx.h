@@ -0,0 +1,65 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __SIM_UBX_H__
+#define __SIM_UBX_H__
+
+#include <stdint.h>
+#include <sim_avr.h>
+#include <sim_irq.h>
+
+#define UBX_TX_BUF_LEN      1024
+
+/**
+ * The fix the model reports at the next epoch
+ */
+typedef struct
+{
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;            // 1e-7 degrees
+    int32_t alt;            // mm above MSL
+    uint8_t lock;           // gpsFix, 0 for no fix
+    uint8_t sats;
+} ubx_fix_t;
+
+/**
+ * A uBlox 6 on USART0, pushing NAV-SOL, NAV-POSLLH and NAV-TIMEUTC once a
+ * second and answering configuration messages.
+ */
+typedef struct ubx_s
+{
+    avr_t* avr;
+    avr_irq_t* rx;          // USART0 input, towards the AVR
+
+    // Bytes waiting to be clocked into the AVR
+    uint8_t tx[UBX_TX_BUF_LEN];
+    uint16_t tx_head;
+    uint16_t tx_tail;
+    uint32_t byte_cycles;
+
+    // Message from the AVR being assembled
+    uint8_t msg[64];
+    uint8_t msg_len;
+
+    uint32_t itow;          // ms, also gives UTC time of day
+    uint8_t dyn_model;
+    ubx_fix_t fix;
+
+    // Called before each epoch is sent to move the fix and time on
+    void (*epoch)(struct ubx_s* ubx, void* param);
+    void* epoch_param;
+
+    uint32_t epochs;
+    uint32_t configs;       // configuration messages acknowledged
+} ubx_t;
+
+void ubx_init(ubx_t* ubx, avr_t* avr, uint32_t baud);
+void ubx_send(ubx_t* ubx, uint8_t cls, uint8_t id, uint8_t* payload,
+        uint16_t len);
+
+#endif /* __SIM_UBX_H__ */
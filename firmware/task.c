@@ -0,0 +1,122 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "task.h"
+
+volatile uint32_t _task_ticks = 0;
+
+// The table main() hands over, found by name by the simulator
+const task_t* task_table = NULL;
+task_stat_t* task_stats = NULL;
+uint8_t task_count = 0;
+
+/**
+ * Start the tick on TIMER0 and take the task table. Every task is due
+ * straight away.
+ */
+void task_init(const task_t* tasks, task_stat_t* stats, uint8_t count)
+{
+    task_table = tasks;
+    task_stats = stats;
+    task_count = count;
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        stats[i].runs = 0;
+        stats[i].time = 0;
+        stats[i].max_time = 0;
+        stats[i].misses = 0;
+        stats[i].due = 0;
+    }
+
+    // CTC mode, prescaled by 64, interrupt once a tick
+    TCCR0A = _BV(WGM01);
+    TCCR0B = _BV(CS01) | _BV(CS00);
+    OCR0A = TASK_TICK_COUNTS - 1;
+    TIMSK0 |= _BV(OCIE0A);
+}
+
+/**
+ * Ticks since task_init(), wrapping.
+ */
+uint16_t task_ticks(void)
+{
+    uint16_t t;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        t = _task_ticks;
+    }
+    return t;
+}
+
+/**
+ * Now in counts of TASK_COUNT_CYCLES, for timing tasks. Allows for a
+ * tick that has happened but not been counted yet.
+ */
+uint32_t _task_now(void)
+{
+    uint32_t ticks;
+    uint8_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = _task_ticks;
+        count = TCNT0;
+        if( (TIFR0 & _BV(OCF0A)) && count < TASK_TICK_COUNTS / 2 )
+            ticks++;
+    }
+    return ticks * TASK_TICK_COUNTS + count;
+}
+
+/**
+ * One pass over the table, running each task that is due once. A task
+ * that starts a whole period or more late counts a miss and runs next
+ * a period from now, otherwise it keeps to its own schedule.
+ */
+void task_run(void)
+{
+    for(uint8_t i = 0; i < task_count; i++)
+    {
+        const task_t* t = &task_table[i];
+        task_stat_t* s = &task_stats[i];
+        uint16_t now = task_ticks();
+        int16_t late = now - s->due;
+
+        if( late < 0 ) continue;
+
+        if( s->runs && late >= (int16_t)t->period )
+        {
+            s->misses++;
+            s->due = now + t->period;
+        }
+        else
+            s->due += t->period;
+
+        uint32_t start = _task_now();
+        t->run();
+        uint32_t took = _task_now() - start;
+
+        s->runs++;
+        s->time += took;
+        if( took > s->max_time )
+            s->max_time = took > 0xFFFF ? 0xFFFF : took;
+    }
+}
+
+/**
+ * Scheduler tick
+ */
+ISR(TIMER0_COMPA_vect)
+{
+    _task_ticks++;
+}
@@ -0,0 +1,51 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __TASK_H__
+#define __TASK_H__
+
+#include <avr/io.h>
+
+// TIMER0 ticks the scheduler at this rate, and times tasks in steps of
+// TASK_COUNT_CYCLES, one count of the timer
+#define TASK_TICK_HZ        1000
+#define TASK_COUNT_CYCLES   64
+#define TASK_TICK_COUNTS    (F_CPU / TASK_COUNT_CYCLES / TASK_TICK_HZ)
+
+// Ticks in a number of milliseconds
+#define TASK_MS(ms)         ((uint16_t)((uint32_t)(ms) * TASK_TICK_HZ / 1000))
+
+/**
+ * One entry in the fixed task table, run to completion every period
+ */
+typedef struct
+{
+    const char* name;
+    void (*run)(void);
+    uint16_t period;        // ticks between runs
+} task_t;
+
+/**
+ * What each task has cost, in counts of TASK_COUNT_CYCLES. make profile
+ * prints these from the simulator.
+ */
+typedef struct
+{
+    uint32_t runs;
+    uint32_t time;          // all runs together
+    uint16_t max_time;      // longest single run
+    uint16_t misses;        // runs that started a whole period late
+    uint16_t due;           // tick the next run is due
+} task_stat_t;
+
+void task_init(const task_t* tasks, task_stat_t* stats, uint8_t count);
+void task_run(void);
+uint16_t task_ticks(void);
+uint32_t _task_now(void);
+
+#endif /* __TASK_H__ */
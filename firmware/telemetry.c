@@ -0,0 +1,120 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+static const char hex[] = "0123456789abcdef";
+
+/**
+ * Render the UKHAS sentence into buf using only integer arithmetic and
+ * return its length. The output is laid out exactly as the old
+ * "$$UKHAS14,%lu,%02u:%02u:%02u,%02.7f,%03.7f,%ld,%.1f,%u,%x" format.
+ */
+uint8_t telemetry_format(char* buf, telemetry_t* t)
+{
+    char* p = buf;
+    const char* callsign = "$$" TELEMETRY_CALLSIGN ",";
+
+    while(*callsign) *p++ = *callsign++;
+
+    p = _telemetry_uint(p, t->tick, 1);
+    *p++ = ',';
+    p = _telemetry_uint(p, t->hour, 2);
+    *p++ = ':';
+    p = _telemetry_uint(p, t->minute, 2);
+    *p++ = ':';
+    p = _telemetry_uint(p, t->second, 2);
+    *p++ = ',';
+    p = _telemetry_coord(p, t->lat);
+    *p++ = ',';
+    p = _telemetry_coord(p, t->lon);
+    *p++ = ',';
+
+    // Altitude in whole metres, truncated towards zero
+    int32_t alt = t->alt / 1000;
+    if( alt < 0 )
+    {
+        *p++ = '-';
+        alt = -alt;
+    }
+    p = _telemetry_uint(p, (uint32_t)alt, 1);
+    *p++ = ',';
+
+    p = _telemetry_temperature(p, t->temperature);
+    *p++ = ',';
+    p = _telemetry_uint(p, t->sats, 1);
+    *p++ = ',';
+
+    // Lock is printed in lower case hex
+    if( t->lock > 0x0F ) *p++ = hex[t->lock >> 4];
+    *p++ = hex[t->lock & 0x0F];
+
+    *p = '\0';
+    return p - buf;
+}
+
+/**
+ * Write value in decimal, zero padded to at least the given number of
+ * digits, and return a pointer to the end.
+ */
+char* _telemetry_uint(char* p, uint32_t value, uint8_t digits)
+{
+    char tmp[10];
+    uint8_t n = 0;
+
+    do {
+        tmp[n++] = '0' + value % 10;
+        value /= 10;
+    } while( value || n < digits );
+
+    while(n) *p++ = tmp[--n];
+    return p;
+}
+
+/**
+ * Write a coordinate held in 1e-7 degrees as a signed decimal with
+ * seven places.
+ */
+char* _telemetry_coord(char* p, int32_t value)
+{
+    uint32_t v = (uint32_t)value;
+    if( value < 0 )
+    {
+        *p++ = '-';
+        v = -v;
+    }
+
+    p = _telemetry_uint(p, v / 10000000, 1);
+    *p++ = '.';
+    return _telemetry_uint(p, v % 10000000, 7);
+}
+
+/**
+ * Write a TMP100 reading (1/16 degC) to one decimal place. Readings are
+ * exact in binary so x.x5 ties round to even, as printf does.
+ */
+char* _telemetry_temperature(char* p, int16_t raw)
+{
+    uint16_t v = (uint16_t)raw;
+    if( raw < 0 )
+    {
+        *p++ = '-';
+        v = -v;
+    }
+
+    uint16_t tenths = (v * 10) / 16;
+    uint8_t rem = (v * 10) % 16;
+    if( rem > 8 || (rem == 8 && (tenths & 1)) ) tenths++;
+
+    p = _telemetry_uint(p, tenths / 10, 1);
+    *p++ = '.';
+    *p++ = '0' + tenths % 10;
+    return p;
+}
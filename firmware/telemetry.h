@@ -0,0 +1,45 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#define TELEMETRY_CALLSIGN  "UKHAS14"
+
+// Longest sentence telemetry_format() can write, with the null: "$$",
+// the callsign and then, each with the separator after it, a 10 digit
+// tick, the time with up to 3 digits a field, two coordinates of up to
+// 12 characters, an altitude of up to 8, a temperature of up to 7, 3
+// digits of sats and 2 of lock
+#define TELEMETRY_MAX_LEN   (2 + sizeof(TELEMETRY_CALLSIGN) + 11 + 12 + \
+                            13 + 13 + 9 + 8 + 4 + 2 + 1)
+
+/**
+ * Everything that goes into one telemetry sentence, in the units the
+ * sensors give us
+ */
+typedef struct
+{
+    uint32_t tick;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;            // 1e-7 degrees
+    int32_t alt;            // mm above MSL
+    int16_t temperature;    // raw TMP100 reading, 1/16 degC
+    uint8_t sats;
+    uint8_t lock;
+} telemetry_t;
+
+uint8_t telemetry_format(char* buf, telemetry_t* t);
+char* _telemetry_uint(char* p, uint32_t value, uint8_t digits);
+char* _telemetry_coord(char* p, int32_t value);
+char* _telemetry_temperature(char* p, int16_t raw);
+
+#endif /* __TELEMETRY_H__ */
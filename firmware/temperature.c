@@ -11,168 +11,174 @@
 #include <avr/interrupt.h>
 #include <stdbool.h>
 #include <string.h>
-#include <util/delay.h>
 #include "temperature.h"
 #include "led.h"
-#include "radio.h"
 
-volatile bool tw_in_progress = false;
-uint8_t tw_byte_tx = 0xFF;
-volatile uint8_t tbuf[3];
-volatile uint8_t* ptr = tbuf;
-volatile uint8_t counter = 0;
+// Where the ISR is in a transfer
+#define TMP100_IDLE         0
+#define TMP100_READ         1   // pointer to temperature, read two bytes
+#define TMP100_TRIGGER      2   // write the config with OS set
+
+volatile uint8_t _tmp100_state = TMP100_IDLE;
+volatile uint8_t _tmp100_tx[2];
+volatile uint8_t _tmp100_tx_len = 0;
+volatile uint8_t _tmp100_pos = 0;
+volatile uint8_t _tmp100_rx[2];
+
+// Last reading, and transfers that went wrong
+volatile int16_t _tmp100_raw = 0;
+volatile uint8_t _tmp100_errors = 0;
 
 /**
- * Set up the TMP100 temperature sensor.
+ * Carry on with the bus, clearing TWINT and adding any of TWSTA, TWSTO
+ * and TWEA.
  */
-void temperature_init()
+static void _tmp100_continue(uint8_t bits)
 {
-    // Set up the prescaler to give a clock frequency of 400kHz
-    TWCR |= _BV(TWPS1);
-    TWBR = 1;
-
-    // Enable the I2C interface and enable interrupts
-    TWCR &= ~(_BV(TWSTO) | _BV(TWSTA));
-    TWCR |= _BV(TWEN) | _BV(TWIE);
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | bits;
 }
 
 /**
- * Turn the I2C interface 'off'.
+ * Load the write that sets the resolution and starts a one-shot
+ * conversion. The part stays shut down in between.
  */
-void temperature_deinit()
+static void _tmp100_load_trigger(void)
 {
-    TWCR &= ~(_BV(TWEN) | _BV(TWIE) | _BV(TWSTA) | _BV(TWSTO));
+    _tmp100_state = TMP100_TRIGGER;
+    _tmp100_tx[0] = TMP100_PTR_CFG;
+    _tmp100_tx[1] = TMP100_CFG_OS | TMP100_CFG_12BIT | TMP100_CFG_SD;
+    _tmp100_tx_len = 2;
+    _tmp100_pos = 0;
 }
 
 /**
- * Return the current temperature.
+ * Set up the TWI at 400kHz and start the first conversion.
  */
-float temperature_read()
+void temperature_init(void)
 {
-    // Set the pointer register to the temperature register
-    temperature_init();
-    tmp100_send_byte(TMP100_PTR_TMP);
-
-    // Empty the buffer and reset the pointer and counter
-    ptr = tbuf;
-    counter = 0;
-    tmp100_read();
-    temperature_deinit();
-
-    // Construct the value to be returned
-    int16_t tmp = (tbuf[0] << 8) | tbuf[1];
-    return (float)(tmp >> 4) * 0.0625;
+    // No prescale, SCL = F_CPU / (16 + 2 TWBR)
+    TWSR = 0;
+    TWBR = (F_CPU / TMP100_SCL_HZ - 16) / 2;
+
+    _tmp100_load_trigger();
+    _tmp100_continue(_BV(TWSTA));
 }
 
 /**
- * Send the given byte to the temperature sensor. This will only ever
- * be used to set the pointer register for now.
+ * Turn the I2C interface 'off'.
  */
-void tmp100_send_byte(uint8_t b)
+void temperature_deinit(void)
 {
-    tw_in_progress = true;
-    tw_byte_tx = b;
+    TWCR = 0;
+    _tmp100_state = TMP100_IDLE;
+}
 
-    // Clear the interrupt flag and begin the tranmission process
-    TWCR &= ~_BV(TWSTO);
-    TWCR |= _BV(TWINT) | _BV(TWSTA);
+/**
+ * Read the conversion started last time and start the next one, all
+ * from the TWI interrupt, so this returns straight away. The part takes
+ * up to 600ms at 12 bits, so calls must be at least that far apart. A
+ * transfer still going from last time has hung and the bus is reset.
+ */
+void temperature_start(void)
+{
+    if( _tmp100_state != TMP100_IDLE )
+    {
+        _tmp100_errors++;
+        TWCR = 0;
+    }
 
-    // Wait until the transmission is complete
-    while(tw_in_progress);
+    _tmp100_state = TMP100_READ;
+    _tmp100_tx[0] = TMP100_PTR_TMP;
+    _tmp100_tx_len = 1;
+    _tmp100_pos = 0;
+    _tmp100_continue(_BV(TWSTA));
 }
 
 /**
- * Read data from the TMP100, which will always be two bytes which comprise
- * the MSB and LSB of a left adjusted 12 bit conversion result.
+ * Return the last temperature the interrupt read, as the raw 12 bit
+ * reading in units of 1/16 degC. It is from the conversion started two
+ * calls of temperature_start() ago.
  */
-void tmp100_read()
+int16_t temperature_get(void)
 {
-    tw_in_progress = true;
-    tw_byte_tx = 0xFF; // this is a a read op
-
-    // Clear the interrupt flag and begin the tranmission process
-    TWCR &= ~_BV(TWSTO);
-    TWCR |= _BV(TWINT) | _BV(TWSTA);
+    return _tmp100_raw;
+}
 
-    while(tw_in_progress);
+/**
+ * Transfers that failed since start up.
+ */
+uint8_t temperature_errors(void)
+{
+    return _tmp100_errors;
 }
 
 /**
- * ISR for the I2C interface when it fires an interrupt for whatever reason.
+ * Step the transfer on each time the TWI finishes something. A read is
+ * the pointer write, a repeated start and two bytes in, then it goes
+ * straight on to trigger the next conversion.
  */
 ISR(TWI_vect)
 {
-    uint8_t twsr = TWSR;
-    // What we do depends on the value of the status register
-    switch(twsr)
+    switch(TWSR & 0xF8)
     {
-        // Start or repeated start, transmit SLAW or SLAR now
+        // Address to write the pointer first, then to read
         case TW_START_SENT:
         case TW_RPT_START_SENT:
-            if(tw_byte_tx != 0xFF) // if we are wanting to transmit (master txer)
+            if( _tmp100_pos < _tmp100_tx_len )
                 TWDR = TMP100_ADDR | 0;
-            else // if we want to receive data (master rxer)
+            else
                 TWDR = TMP100_ADDR | 1;
-
-            // Clear the start/stop bit generator and continue the transfer
-            TWCR &= ~(_BV(TWSTA) | _BV(TWSTO));
-            TWCR |= _BV(TWINT) | _BV(TWEN);
+            _tmp100_continue(0);
             break;
 
-        // SLAW has been ack'ed, transmit a DATA packet to the device
         case TW_SLAW_ACK:
-            TWDR = tw_byte_tx;
-            TWCR |= _BV(TWINT) | _BV(TWEN);
+        case TW_WDATA_ACK:
+            if( _tmp100_pos < _tmp100_tx_len )
+            {
+                TWDR = _tmp100_tx[_tmp100_pos++];
+                _tmp100_continue(0);
+            }
+            else if( _tmp100_state == TMP100_READ )
+            {
+                _tmp100_pos = 0;
+                _tmp100_tx_len = 0;
+                _tmp100_continue(_BV(TWSTA));
+            }
+            else
+            {
+                _tmp100_state = TMP100_IDLE;
+                _tmp100_continue(_BV(TWSTO));
+            }
             break;
 
+        // ACK the MSB, NACK the LSB to end the read
         case TW_SLAR_ACK:
-            // Enable ACKs from the AVR for incoming bytes
-            TWCR |= _BV(TWINT) | _BV(TWEA) | _BV(TWEN);
-            break;
-
-        case TW_WDATA_ACK:
-            // Byte successfully transmitted, send a stop condition
-            // TODO: We can only ever transmit a single byte!
-            TWCR |= _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-            tw_in_progress = false;
+            _tmp100_continue(_BV(TWEA));
             break;
 
         case TW_RDATA_ACK:
-            // There is a byte to be read and we ack'ed it
-            *ptr++ = TWDR;
-            counter++;
-            if(counter == 1) // NACK the data
-            {
-                TWCR &= ~(_BV(TWEA));
-                TWCR |= _BV(TWINT);
-            } else { // ACK the data
-                TWCR |= _BV(TWINT) | _BV(TWEA);
-            }
+            _tmp100_rx[0] = TWDR;
+            _tmp100_continue(0);
             break;
 
         case TW_RDATA_NACK:
-            // This is the final byte in the transmission, null terminate the
-            // buffer
-            // TODO: We always receive two bytes, this should not be hardcoded
-            *ptr++ = TWDR;
-            *ptr++ = 0x00;
-            counter++;
-            tw_in_progress = false;
+            _tmp100_rx[1] = TWDR;
+            _tmp100_raw = (int16_t)(_tmp100_rx[0] << 8 | _tmp100_rx[1]) >> 4;
+            _tmp100_load_trigger();
+            _tmp100_continue(_BV(TWSTA));
             break;
 
         // No relevant state information, TWINT=0. Why are we here?
         case TW_NO_STATE_INFO:
             break;
 
-        // Bus error due to illegal start/stop condition. Bus is released by
-        // hardware.
-        case TW_BUS_ERROR:
-            led_set(LED_RED, 1);
-
+        // Not there, lost the bus or a bus error. Give up on this one and
+        // keep the last reading.
         default:
             led_set(LED_RED, 1);
+            _tmp100_errors++;
+            _tmp100_state = TMP100_IDLE;
+            _tmp100_continue(_BV(TWSTO));
             break;
     }
-    return;
 }
-
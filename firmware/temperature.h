@@ -15,6 +15,13 @@
 #define     TMP100_PTR_TMP          0x00
 #define     TMP100_PTR_CFG          0x01
 
+// Config register bits, shut down between one-shot 12 bit conversions
+#define     TMP100_CFG_SD           0x01
+#define     TMP100_CFG_12BIT        0x60
+#define     TMP100_CFG_OS           0x80
+
+#define     TMP100_SCL_HZ           400000UL
+
 // Status codes for the TWI
 #define     TW_START_SENT           0x08
 #define     TW_RPT_START_SENT       0x10
@@ -31,8 +38,9 @@
 #define     TW_BUS_ERROR            0x00
 
 void temperature_init(void);
-float temperature_read(void);
-void tmp100_send_byte(uint8_t b);
-void tmp100_read(void);
+void temperature_deinit(void);
+void temperature_start(void);
+int16_t temperature_get(void);
+uint8_t temperature_errors(void);
 
 #endif /* __TEMPERATURE_H__ */
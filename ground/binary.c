@@ -0,0 +1,205 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Decode Joey-M binary telemetry frames from demodulated soft bits.
+ * Usage:
+ *
+ *     binary [options] softbits
+ *
+ *     -T score     how well the sync word has to match to try decoding
+ *                  there, 1 being perfect, default 0.5
+ *     -i count     most decoder iterations per frame, default 8
+ *     -t threads   default one per CPU
+ *     -a           also print candidates that do not unpack and do not
+ *                  overlap a frame that did
+ *
+ * The input is 32 bit floats, one per bit, positive for a 1 and scaled
+ * any way the demodulator likes. Anywhere the sync word roughly matches,
+ * either way up, is a candidate frame. They are all turbo decoded in
+ * parallel and those whose CRC matches and that unpack into a telemetry
+ * map are kept, which finds frames near the limit of the code where 32
+ * bits of sync are not enough on their own. Each is printed with the bit it started on,
+ * followed by any older fixes it carried.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "turbo.h"
+#include "packet.h"
+
+#define BINARY_MAX_THREADS  256
+
+/**
+ * Everything the threads share
+ */
+typedef struct
+{
+    turbo_t turbo;
+    const float* soft;
+    packet_t* packets;
+    size_t count;
+    int iterations;
+    volatile size_t next;
+} binary_t;
+
+static void* binary_thread(void* param)
+{
+    binary_t* b = (binary_t*)param;
+    size_t i;
+
+    while( (i = __sync_fetch_and_add(&b->next, 1)) < b->count )
+    {
+        packet_t* p = &b->packets[i];
+        packet_decode(&b->turbo, b->soft + p->at + PACKET_SYNC_BITS,
+                b->iterations, p);
+    }
+    return NULL;
+}
+
+static double binary_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-T score] [-i count] [-t threads] [-a] "
+            "softbits\n", name);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    static binary_t b;
+    float threshold = 0.5;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool all = false;
+    int opt;
+
+    b.iterations = TURBO_ITERATIONS;
+
+    while( (opt = getopt(argc, argv, "T:i:t:a")) != -1 )
+    {
+        switch(opt)
+        {
+            case 'T': threshold = atof(optarg); break;
+            case 'i': b.iterations = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'a': all = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if( optind != argc - 1 || b.iterations < 1 ) usage(argv[0]);
+
+    struct stat st;
+    int fd = open(argv[optind], O_RDONLY);
+    if( fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(float) )
+    {
+        fprintf(stderr, "%s: cannot read\n", argv[optind]);
+        return 1;
+    }
+    b.soft = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( b.soft == MAP_FAILED )
+    {
+        fprintf(stderr, "%s: cannot map\n", argv[optind]);
+        return 1;
+    }
+    size_t n = st.st_size / sizeof(float);
+
+    turbo_init(&b.turbo, TURBO_K_376, TURBO_F1_376, TURBO_F2_376);
+    size_t frame = PACKET_SYNC_BITS + turbo_coded_bits(&b.turbo);
+    double t0 = binary_now();
+
+    // Every candidate is decoded, the ones that fail are sorted out after
+    size_t size = 0, at = 0;
+    float score;
+    while( (at = packet_find(b.soft, n, at, threshold, &score)) < n )
+    {
+        if( b.count == size )
+        {
+            size = size ? size * 2 : 64;
+            b.packets = realloc(b.packets, size * sizeof(packet_t));
+        }
+        memset(&b.packets[b.count], 0, sizeof(packet_t));
+        b.packets[b.count].at = at;
+        b.packets[b.count].sync = score;
+        b.count++;
+        at++;
+    }
+
+    if( threads < 1 ) threads = 1;
+    if( threads > BINARY_MAX_THREADS ) threads = BINARY_MAX_THREADS;
+    if( (size_t)threads > b.count ) threads = b.count ? b.count : 1;
+
+    pthread_t pool[BINARY_MAX_THREADS];
+    for(long i = 0; i < threads; i++)
+        pthread_create(&pool[i], NULL, binary_thread, &b);
+    for(long i = 0; i < threads; i++)
+        pthread_join(pool[i], NULL);
+    double took = binary_now() - t0;
+
+    // Candidates come in order, so a frame that unpacked wins over any
+    // failure overlapping it either side
+    size_t good = 0, end = 0;
+    for(size_t i = 0; i < b.count; i++)
+    {
+        packet_t* p = &b.packets[i];
+        if( p->ok )
+        {
+            if( p->at < end ) continue;
+            good++;
+            end = p->at + frame;
+        }
+        else
+        {
+            if( !all || p->at < end ) continue;
+            if( i + 1 < b.count && b.packets[i + 1].ok &&
+                    b.packets[i + 1].at < p->at + frame )
+                continue;
+        }
+
+        printf("%10zu %s", p->at, p->ok ? "OK " : "BAD");
+        if( p->ok )
+        {
+            printf(" %s tick %u %02u:%02u:%02u %.7f %.7f %d m, %u sats, "
+                    "lock %u", p->id, p->tick, p->time / 3600,
+                    p->time / 60 % 60, p->time % 60, p->lat * 1e-7,
+                    p->lon * 1e-7, p->alt, p->sats, p->lock);
+        }
+        printf(" (sync %.2f, %d iterations, %u corrected)\n", p->sync,
+                p->iterations, p->corrected);
+
+        for(int j = 0; j < p->history; j++)
+        {
+            packet_fix_t* f = &p->fixes[j];
+            printf("%10s        %02u:%02u:%02u %.7f %.7f %d m\n", "",
+                    f->time / 3600, f->time / 60 % 60, f->time % 60,
+                    f->lat * 1e-7, f->lon * 1e-7, f->alt);
+        }
+    }
+
+    fprintf(stderr, "%zu frames from %zu candidates in %zu bits, %.3f s on "
+            "%ld threads, %.0f candidates/s\n", good, b.count, n, took,
+            threads, b.count / took);
+
+    free(b.packets);
+    turbo_free(&b.turbo);
+    munmap((void*)b.soft, st.st_size);
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ddc.h"
+
+typedef float v8f __attribute__((vector_size(32)));
+
+static void* _ddc_alloc(size_t len)
+{
+    void* p = NULL;
+    if( posix_memalign(&p, 32, len) != 0 ) abort();
+    memset(p, 0, len);
+    return p;
+}
+
+/**
+ * Set up to decimate a recording at rate by decim, keeping cutoff Hz
+ * either side of the carrier. The filter is a Blackman windowed sinc
+ * with unity gain at 0Hz.
+ */
+void ddc_init(ddc_t* ddc, uint32_t rate, float cutoff, uint32_t decim)
+{
+    memset(ddc, 0, sizeof(*ddc));
+    ddc->rate = rate;
+    ddc->decim = decim;
+    ddc->taps = (decim * DDC_TAPS_PER_DECIM + 7) & ~7u;
+    ddc->h = _ddc_alloc(ddc->taps * sizeof(float));
+    ddc->re = _ddc_alloc((ddc->taps + DDC_BLOCK) * sizeof(float));
+    ddc->im = _ddc_alloc((ddc->taps + DDC_BLOCK) * sizeof(float));
+
+    double fc = (double)cutoff / rate, sum = 0;
+    for(uint32_t n = 0; n < ddc->taps; n++)
+    {
+        double x = n - (ddc->taps - 1) / 2.0;
+        double w = 2 * M_PI * n / (ddc->taps - 1);
+        double h = x == 0 ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x);
+        h *= 0.42 - 0.5 * cos(w) + 0.08 * cos(2 * w);
+        ddc->h[n] = h;
+        sum += h;
+    }
+    for(uint32_t n = 0; n < ddc->taps; n++)
+        ddc->h[n] /= sum;
+}
+
+/**
+ * Mix len samples at re, im down by hz, eight at a time.
+ */
+static void _ddc_mix(ddc_t* ddc, float* re, float* im, size_t len,
+        double hz)
+{
+    double w = 2 * M_PI * hz / ddc->rate;
+    v8f c, s;
+
+    for(int l = 0; l < 8; l++)
+    {
+        double ph = 2 * M_PI * ddc->phase + w * l;
+        c[l] = cos(ph);
+        s[l] = sin(ph);
+    }
+    float cr = cos(8 * w), sr = sin(8 * w);
+
+    for(size_t i = 0; i < len; i += 8)
+    {
+        v8f xr, xi;
+        memcpy(&xr, &re[i], sizeof(xr));
+        memcpy(&xi, &im[i], sizeof(xi));
+
+        v8f mi = xr * c + xi * s;
+        v8f mq = xi * c - xr * s;
+        memcpy(&re[i], &mi, sizeof(mi));
+        memcpy(&im[i], &mq, sizeof(mq));
+
+        v8f nc = c * cr - s * sr;
+        s = s * cr + c * sr;
+        c = nc;
+    }
+
+    ddc->phase = fmod(ddc->phase + hz * len / ddc->rate, 1.0);
+}
+
+/**
+ * Run n samples of src from start through, mixing down by hz. Output
+ * samples go to out as I/Q pairs and the number written is returned,
+ * at most n / decim + 1.
+ */
+size_t ddc_run(ddc_t* ddc, source_t* src, size_t start, size_t n,
+        double hz, float* out)
+{
+    uint32_t keep = ddc->taps - 1;
+    size_t made = 0;
+
+    while( n )
+    {
+        size_t len = n < DDC_BLOCK ? n : DDC_BLOCK;
+        float* re = ddc->re + keep;
+        float* im = ddc->im + keep;
+
+        source_read(src, start, len, re, im);
+        _ddc_mix(ddc, re, im, (len + 7) & ~7u, hz);
+
+        // Output i is the filter over the taps ending at block sample i
+        size_t i = ddc->skip;
+        for( ; i < len; i += ddc->decim)
+        {
+            v8f ar = {0}, ai = {0};
+            for(uint32_t t = 0; t < ddc->taps; t += 8)
+            {
+                v8f h, xr, xi;
+                memcpy(&h, &ddc->h[t], sizeof(h));
+                memcpy(&xr, &ddc->re[i + t], sizeof(xr));
+                memcpy(&xi, &ddc->im[i + t], sizeof(xi));
+                ar += h * xr;
+                ai += h * xi;
+            }
+
+            float sr = 0, si = 0;
+            for(int l = 0; l < 8; l++)
+            {
+                sr += ar[l];
+                si += ai[l];
+            }
+            out[2 * made] = sr;
+            out[2 * made + 1] = si;
+            made++;
+        }
+        ddc->skip = i - len;
+
+        memmove(ddc->re, ddc->re + len, keep * sizeof(float));
+        memmove(ddc->im, ddc->im + len, keep * sizeof(float));
+        start += len;
+        n -= len;
+    }
+    return made;
+}
+
+void ddc_free(ddc_t* ddc)
+{
+    free(ddc->h);
+    free(ddc->re);
+    free(ddc->im);
+}
@@ -0,0 +1,43 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __DDC_H__
+#define __DDC_H__
+
+#include <stdint.h>
+#include "source.h"
+
+// Input samples mixed at a time, a multiple of 8
+#define DDC_BLOCK       4096
+
+// Filter taps per output sample skipped
+#define DDC_TAPS_PER_DECIM  16
+
+/**
+ * Pulls one channel out of a recording: mixes it down to 0Hz, low pass
+ * filters and decimates. The oscillator phase carries on between calls
+ * so the frequency can follow a drifting carrier.
+ */
+typedef struct
+{
+    uint32_t rate;          // of the recording
+    uint32_t decim;
+    uint32_t taps;          // a multiple of 8
+    float* h;
+    float* re;              // taps - 1 of history then a block
+    float* im;
+    double phase;           // of the oscillator, in cycles
+    uint32_t skip;          // input samples until the next output
+} ddc_t;
+
+void ddc_init(ddc_t* ddc, uint32_t rate, float cutoff, uint32_t decim);
+size_t ddc_run(ddc_t* ddc, source_t* src, size_t start, size_t n,
+        double hz, float* out);
+void ddc_free(ddc_t* ddc);
+
+#endif /* __DDC_H__ */
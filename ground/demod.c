@@ -0,0 +1,191 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Decode Joey-M RTTY from a recording, splitting it between threads.
+ * Usage:
+ *
+ *     demod [options] recording
+ *
+ *     -m afsk|fsk  AFSK tones (1000/750Hz) or FSK with a 425Hz shift
+ *     -f hz        FSK space tone, mark is 425Hz above, default 0 for IQ
+ *                  and 1000Hz for audio
+ *     -M hz -S hz  mark and space tones, overriding -m and -f
+ *     -b baud      50 (default) or 300
+ *     -r rate      sample rate of a raw cf32 recording, default 62500
+ *     -i           a two channel WAV is I and Q
+ *     -t threads   default one per CPU
+ *     -a           also print sentences that fail the checksum
+ *
+ * Each sentence is printed with the time into the recording it started.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "source.h"
+#include "rtty.h"
+
+// Tones radio.c uses, see RADIO_AFSK_* and RADIO_SHIFT_425
+#define DEMOD_AFSK_MARK     1000.0f
+#define DEMOD_AFSK_SPACE    750.0f
+#define DEMOD_FSK_SHIFT     425.0f
+#define DEMOD_AUDIO_SPACE   1000.0f
+
+#define DEMOD_MAX_THREADS   256
+
+/**
+ * One thread's share of the recording and what it found there
+ */
+typedef struct
+{
+    pthread_t thread;
+    source_t* src;
+    rtty_config_t* cfg;
+    size_t start;
+    size_t end;
+    rtty_sentence_t* found;
+    size_t count;
+    size_t size;
+} demod_job_t;
+
+static void demod_found(rtty_sentence_t* s, void* param)
+{
+    demod_job_t* job = (demod_job_t*)param;
+
+    if( job->count == job->size )
+    {
+        job->size = job->size ? job->size * 2 : 64;
+        job->found = realloc(job->found, job->size * sizeof(*job->found));
+    }
+    job->found[job->count++] = *s;
+}
+
+static void* demod_thread(void* param)
+{
+    demod_job_t* job = (demod_job_t*)param;
+    rtty_decode(job->src, job->cfg, job->start, job->end, demod_found, job);
+    return NULL;
+}
+
+static double demod_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-m afsk|fsk] [-f hz] [-M hz] [-S hz] "
+            "[-b baud] [-r rate] [-i] [-t threads] [-a] recording\n", name);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    rtty_config_t cfg = {0, 0, 50};
+    const char* mode = "afsk";
+    float mark = 0, space = 0, fsk_space = -1;
+    uint32_t rate = 62500;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool iq = false, all = false;
+    int opt;
+
+    while( (opt = getopt(argc, argv, "m:f:M:S:b:r:it:a")) != -1 )
+    {
+        switch(opt)
+        {
+            case 'm': mode = optarg; break;
+            case 'f': fsk_space = atof(optarg); break;
+            case 'M': mark = atof(optarg); break;
+            case 'S': space = atof(optarg); break;
+            case 'b': cfg.baud = atof(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'i': iq = true; break;
+            case 't': threads = atoi(optarg); break;
+            case 'a': all = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if( optind != argc - 1 || cfg.baud <= 0 ) usage(argv[0]);
+
+    source_t src;
+    if( source_open(&src, argv[optind], rate, iq) != 0 )
+    {
+        fprintf(stderr, "%s: cannot read\n", argv[optind]);
+        return 1;
+    }
+
+    if( strcmp(mode, "afsk") == 0 )
+    {
+        cfg.mark = DEMOD_AFSK_MARK;
+        cfg.space = DEMOD_AFSK_SPACE;
+    }
+    else if( strcmp(mode, "fsk") == 0 )
+    {
+        if( fsk_space < 0 ) fsk_space = src.iq ? 0 : DEMOD_AUDIO_SPACE;
+        cfg.space = fsk_space;
+        cfg.mark = fsk_space + DEMOD_FSK_SHIFT;
+    }
+    else
+        usage(argv[0]);
+    if( mark ) cfg.mark = mark;
+    if( space ) cfg.space = space;
+
+    // Each thread reads a margin either side of its share, so do not cut
+    // the recording up finer than that is worth
+    size_t margin = rtty_margin(&src, &cfg);
+    if( threads < 1 ) threads = 1;
+    if( threads > DEMOD_MAX_THREADS ) threads = DEMOD_MAX_THREADS;
+    if( (size_t)threads > src.samples / (4 * margin) )
+        threads = src.samples / (4 * margin) + 1;
+
+    demod_job_t* jobs = calloc(threads, sizeof(demod_job_t));
+    size_t share = (src.samples + threads - 1) / threads;
+    double t0 = demod_now();
+
+    for(long i = 0; i < threads; i++)
+    {
+        jobs[i].src = &src;
+        jobs[i].cfg = &cfg;
+        jobs[i].start = i * share;
+        jobs[i].end = (i + 1) * share < src.samples ? (i + 1) * share :
+            src.samples;
+        pthread_create(&jobs[i].thread, NULL, demod_thread, &jobs[i]);
+    }
+
+    size_t good = 0, bad = 0;
+    for(long i = 0; i < threads; i++)
+    {
+        pthread_join(jobs[i].thread, NULL);
+        for(size_t j = 0; j < jobs[i].count; j++)
+        {
+            rtty_sentence_t* s = &jobs[i].found[j];
+            if( s->crc_ok ) good++;
+            else bad++;
+            if( s->crc_ok || all )
+                printf("%10.3f %s %s\n", (double)s->at / src.rate,
+                        s->crc_ok ? "OK " : "BAD", s->text);
+        }
+        free(jobs[i].found);
+    }
+
+    double took = demod_now() - t0;
+    double length = (double)src.samples / src.rate;
+    fprintf(stderr, "%zu good, %zu bad sentences in %.1f s of recording, "
+            "%.2f s on %ld threads, %.0fx real time\n", good, bad, length,
+            took, threads, length / took);
+
+    free(jobs);
+    source_close(&src);
+    return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "fft.h"
+
+/**
+ * Set up for n points, which must be a power of two. Returns 0 on
+ * success.
+ */
+int fft_init(fft_t* fft, uint32_t n)
+{
+    uint32_t bits = 0;
+
+    if( n < 2 || (n & (n - 1)) ) return -1;
+    while( (1u << bits) < n ) bits++;
+
+    fft->n = n;
+    fft->rev = malloc(n * sizeof(uint32_t));
+    fft->wr = malloc(n / 2 * sizeof(float));
+    fft->wi = malloc(n / 2 * sizeof(float));
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = 0;
+        for(uint32_t b = 0; b < bits; b++)
+            if( i & (1u << b) ) r |= 1u << (bits - 1 - b);
+        fft->rev[i] = r;
+    }
+    for(uint32_t i = 0; i < n / 2; i++)
+    {
+        fft->wr[i] = cos(2 * M_PI * i / n);
+        fft->wi[i] = -sin(2 * M_PI * i / n);
+    }
+    return 0;
+}
+
+/**
+ * Forward transform, X[k] = sum x[n] e^-j2(pi)kn/N, in place.
+ */
+void fft_run(fft_t* fft, float* re, float* im)
+{
+    uint32_t n = fft->n;
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = fft->rev[i];
+        if( r > i )
+        {
+            float t = re[i]; re[i] = re[r]; re[r] = t;
+            t = im[i]; im[i] = im[r]; im[r] = t;
+        }
+    }
+
+    for(uint32_t len = 2; len <= n; len <<= 1)
+    {
+        uint32_t half = len / 2;
+        uint32_t step = n / len;
+
+        for(uint32_t i = 0; i < n; i += len)
+        {
+            for(uint32_t j = 0; j < half; j++)
+            {
+                float wr = fft->wr[j * step], wi = fft->wi[j * step];
+                uint32_t a = i + j, b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void fft_free(fft_t* fft)
+{
+    free(fft->rev);
+    free(fft->wr);
+    free(fft->wi);
+}
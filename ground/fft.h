@@ -0,0 +1,29 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <stdint.h>
+
+/**
+ * Plan for an in place radix 2 complex FFT of n points
+ */
+typedef struct
+{
+    uint32_t n;
+    uint32_t* rev;          // bit reversed index of each point
+    float* wr;              // twiddles, n/2 of each
+    float* wi;
+} fft_t;
+
+int fft_init(fft_t* fft, uint32_t n);
+void fft_run(fft_t* fft, float* re, float* im);
+void fft_free(fft_t* fft);
+
+#endif /* __FFT_H__ */
@@ -0,0 +1,188 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include "msgpack.h"
+
+// Nesting msgpack_skip() will follow before giving up
+#define MSGPACK_MAX_DEPTH   8
+
+void msgpack_init(msgpack_t* m, const uint8_t* buf, size_t len)
+{
+    m->p = buf;
+    m->end = buf + len;
+}
+
+/**
+ * Read a big endian value of len bytes from just after the type byte.
+ */
+static bool _msgpack_be(msgpack_t* m, uint8_t len, uint64_t* v)
+{
+    if( m->end - m->p < 1 + len ) return false;
+    *v = 0;
+    for(uint8_t i = 0; i < len; i++)
+        *v = *v << 8 | m->p[1 + i];
+    return true;
+}
+
+/**
+ * Any of the integer encodings, signed or not.
+ */
+bool msgpack_read_int(msgpack_t* m, int64_t* v)
+{
+    uint64_t u;
+    uint8_t len;
+
+    if( m->p >= m->end ) return false;
+    uint8_t t = *m->p;
+
+    if( t <= 0x7F || t >= 0xE0 )
+    {
+        *v = t <= 0x7F ? t : (int8_t)t;
+        m->p++;
+        return true;
+    }
+    if( t >= 0xCC && t <= 0xD3 )
+    {
+        len = 1 << ((t - 0xCC) & 3);
+        if( !_msgpack_be(m, len, &u) ) return false;
+        if( t >= 0xD0 && len < 8 && u >> (8 * len - 1) )
+            u |= ~0ULL << (8 * len);
+        *v = (int64_t)u;
+        m->p += 1 + len;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * A string, left where it is in the buffer and not terminated.
+ */
+bool msgpack_read_str(msgpack_t* m, const char** s, uint32_t* len)
+{
+    uint64_t n;
+    uint8_t head;
+
+    if( m->p >= m->end ) return false;
+    uint8_t t = *m->p;
+
+    if( (t & 0xE0) == 0xA0 )
+    {
+        n = t & 0x1F;
+        head = 1;
+    }
+    else if( t >= 0xD9 && t <= 0xDB )
+    {
+        uint8_t bytes = 1 << (t - 0xD9);
+        if( !_msgpack_be(m, bytes, &n) ) return false;
+        head = 1 + bytes;
+    }
+    else
+        return false;
+
+    if( (uint64_t)(m->end - m->p - head) < n ) return false;
+    *s = (const char*)m->p + head;
+    *len = n;
+    m->p += head + n;
+    return true;
+}
+
+/**
+ * A binary blob, left where it is in the buffer.
+ */
+bool msgpack_read_bin(msgpack_t* m, const uint8_t** b, uint32_t* len)
+{
+    uint64_t n;
+
+    if( m->p >= m->end ) return false;
+    uint8_t t = *m->p;
+    if( t < 0xC4 || t > 0xC6 ) return false;
+
+    uint8_t bytes = 1 << (t - 0xC4);
+    if( !_msgpack_be(m, bytes, &n) ) return false;
+    if( (uint64_t)(m->end - m->p - 1 - bytes) < n ) return false;
+    *b = m->p + 1 + bytes;
+    *len = n;
+    m->p += 1 + bytes + n;
+    return true;
+}
+
+/**
+ * The header of an array or map, fix is the fixed size type with the
+ * count in its low four bits and wide the 16 bit form.
+ */
+static bool _msgpack_count(msgpack_t* m, uint8_t fix, uint8_t wide,
+        uint32_t* n)
+{
+    uint64_t v;
+
+    if( m->p >= m->end ) return false;
+    uint8_t t = *m->p;
+
+    if( (t & 0xF0) == fix )
+    {
+        *n = t & 0x0F;
+        m->p++;
+        return true;
+    }
+    if( t == wide || t == wide + 1 )
+    {
+        uint8_t bytes = t == wide ? 2 : 4;
+        if( !_msgpack_be(m, bytes, &v) ) return false;
+        *n = v;
+        m->p += 1 + bytes;
+        return true;
+    }
+    return false;
+}
+
+bool msgpack_read_array(msgpack_t* m, uint32_t* n)
+{
+    return _msgpack_count(m, 0x90, 0xDC, n);
+}
+
+bool msgpack_read_map(msgpack_t* m, uint32_t* n)
+{
+    return _msgpack_count(m, 0x80, 0xDE, n);
+}
+
+static bool _msgpack_skip(msgpack_t* m, int depth)
+{
+    int64_t i;
+    const char* s;
+    const uint8_t* b;
+    uint32_t n;
+
+    if( depth > MSGPACK_MAX_DEPTH || m->p >= m->end ) return false;
+    uint8_t t = *m->p;
+
+    if( msgpack_read_int(m, &i) || msgpack_read_str(m, &s, &n) ||
+            msgpack_read_bin(m, &b, &n) )
+        return true;
+    if( t == 0xC0 || t == 0xC2 || t == 0xC3 )
+    {
+        m->p++;
+        return true;
+    }
+    if( msgpack_read_array(m, &n) || msgpack_read_map(m, &n) )
+    {
+        if( (t & 0xF0) == 0x80 || t == 0xDE || t == 0xDF ) n *= 2;
+        while( n-- )
+            if( !_msgpack_skip(m, depth + 1) ) return false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Step over the next object, whatever it is, as long as it is not a
+ * float or extension type which telemetry never uses.
+ */
+bool msgpack_skip(msgpack_t* m)
+{
+    return _msgpack_skip(m, 0);
+}
@@ -0,0 +1,35 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __MSGPACK_H__
+#define __MSGPACK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A MessagePack buffer being read from the front. Every read returns
+ * false and leaves the buffer alone if the next object is not of the
+ * type asked for, or runs off the end.
+ */
+typedef struct
+{
+    const uint8_t* p;
+    const uint8_t* end;
+} msgpack_t;
+
+void msgpack_init(msgpack_t* m, const uint8_t* buf, size_t len);
+bool msgpack_read_int(msgpack_t* m, int64_t* v);
+bool msgpack_read_str(msgpack_t* m, const char** s, uint32_t* len);
+bool msgpack_read_bin(msgpack_t* m, const uint8_t** b, uint32_t* len);
+bool msgpack_read_array(msgpack_t* m, uint32_t* n);
+bool msgpack_read_map(msgpack_t* m, uint32_t* n);
+bool msgpack_skip(msgpack_t* m);
+
+#endif /* __MSGPACK_H__ */
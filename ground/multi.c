@@ -0,0 +1,750 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Find every Joey-M in a wideband IQ recording and decode them all.
+ * Usage:
+ *
+ *     multi [options] recording
+ *
+ *     -r rate      sample rate of a raw cf32 recording, default 250000
+ *     -i           a two channel WAV is I and Q, which is assumed
+ *     -F hz        centre frequency, to print absolute frequencies
+ *     -b baud      50 (default) or 300
+ *     -m afsk|fsk  decode every signal as this rather than guessing
+ *     -c hz        channel width to search with, default 500Hz
+ *     -w seconds   time to average each spectrum over, default 0.5s
+ *     -T db        how far above the noise a channel has to be to count
+ *                  as a signal, default 3dB
+ *     -d hz        ignore anything this close to 0Hz, for receivers with
+ *                  a spike there
+ *     -t threads   default one per CPU
+ *     -a           also print sentences that fail the checksum
+ *     -v           list the signals found
+ *
+ * First a polyphase filterbank splits the recording into narrow channels
+ * and measures the power in each over short windows, split between
+ * threads by time. Runs of channels standing out from the noise are
+ * grouped into signals and followed as they drift. Each signal is then
+ * pulled out with its own mixer and decimator following that drift, and
+ * demodulated, split between threads by signal. Wide signals are taken
+ * to be AFSK on FM and narrow ones FSK.
+ *
+ * Sentences are printed in time order with the frequency they came from.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include "source.h"
+#include "pfb.h"
+#include "ddc.h"
+#include "rtty.h"
+
+// Tones radio.c uses, see RADIO_AFSK_* and RADIO_SHIFT_425
+#define MULTI_AFSK_MARK     1000.0f
+#define MULTI_AFSK_SPACE    750.0f
+#define MULTI_FSK_SHIFT     425.0f
+
+// AFSK swings FINE over its whole range, about 11kHz of deviation, so
+// anything wider than this is taken to be AFSK
+#define MULTI_AFSK_WIDTH    5000.0f
+
+// Channel bandwidth either side of the carrier and rate it is pulled out
+// at. AFSK is FM demodulated and then brought down to the audio rate.
+#define MULTI_AFSK_CUTOFF   7500.0f
+#define MULTI_AFSK_RATE     20000
+#define MULTI_AUDIO_RATE    4000
+#define MULTI_FSK_CUTOFF    1000.0f
+#define MULTI_FSK_RATE      4000
+
+// FSK is retuned every MULTI_FSK_SEGMENT seconds, by up to MULTI_FSK_PULL
+// Hz, looking at the spectrum MULTI_FSK_BLOCK seconds at a time
+#define MULTI_FSK_SEGMENT   2.0
+#define MULTI_FSK_PULL      150.0
+#define MULTI_FSK_BLOCK     0.5
+
+// Channels this close together are part of the same signal, and the
+// width the power is averaged over to pick out AFSK
+#define MULTI_GAP_HZ        3000.0f
+#define MULTI_SPREAD_HZ     1000.0f
+
+// A signal this close to where a track was last seen, in the last
+// MULTI_HOLD seconds, carries it on. Tracks shorter than MULTI_MIN_LEN
+// seconds are dropped and the frequency is averaged over MULTI_SMOOTH.
+#define MULTI_ASSOC_HZ      2000.0f
+#define MULTI_HOLD          10.0
+#define MULTI_MIN_LEN       2.0
+#define MULTI_SMOOTH        10.0
+
+#define MULTI_MAX_THREADS   256
+#define MULTI_MAX_TRACKS    256
+
+/**
+ * A run of channels standing out from the noise in one window
+ */
+typedef struct
+{
+    float hz;
+    float power;
+    float width;
+} multi_cluster_t;
+
+/**
+ * One transmitter followed through the recording, and what was decoded
+ * from it
+ */
+typedef struct
+{
+    uint32_t first;         // windows it was seen in
+    uint32_t last;
+    uint32_t seen;
+    uint32_t wide;
+    float last_hz;
+    float* hz;              // per window, NAN where it was not seen
+    bool afsk;
+
+    uint32_t from;          // windows pulled out, with some either side
+    uint32_t to;
+    double rate;            // of what was demodulated
+    rtty_sentence_t* found;
+    size_t count;
+    size_t size;
+} multi_track_t;
+
+/**
+ * Everything the threads share
+ */
+typedef struct
+{
+    source_t src;
+    uint32_t channels;
+    uint32_t frames;        // filterbank outputs per window
+    size_t window;          // samples per window
+    uint32_t windows;
+    float* power;           // windows * channels
+
+    multi_track_t tracks[MULTI_MAX_TRACKS];
+    uint32_t ntracks;
+    volatile uint32_t next;
+
+    rtty_config_t cfg;
+    const char* mode;
+} multi_t;
+
+/**
+ * A share of the windows for the filterbank
+ */
+typedef struct
+{
+    pthread_t thread;
+    multi_t* m;
+    uint32_t from;
+    uint32_t to;
+} multi_job_t;
+
+static void* multi_spectrum_thread(void* param)
+{
+    multi_job_t* job = (multi_job_t*)param;
+    multi_t* m = job->m;
+    pfb_t pfb;
+
+    pfb_init(&pfb, m->channels, m->frames);
+    for(uint32_t w = job->from; w < job->to; w++)
+        pfb_power(&pfb, &m->src, w * m->window, m->frames,
+                &m->power[(size_t)w * m->channels]);
+    pfb_free(&pfb);
+    return NULL;
+}
+
+static int multi_cmp_float(const void* a, const void* b)
+{
+    float x = *(const float*)a, y = *(const float*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int multi_cmp_cluster(const void* a, const void* b)
+{
+    float x = ((const multi_cluster_t*)a)->power;
+    float y = ((const multi_cluster_t*)b)->power;
+    return x > y ? -1 : x < y;
+}
+
+/**
+ * Group the channels in one window that stand threshold above the median
+ * into signals. AFSK is spread thinly over many channels with holes
+ * between the FM sidebands, so the test is also made on the power
+ * averaged over MULTI_SPREAD_HZ. Returns how many were found.
+ */
+static uint32_t multi_detect(multi_t* m, uint32_t w, float threshold,
+        float dc_hz, multi_cluster_t* out, uint32_t max)
+{
+    uint32_t n = m->channels;
+    const float* raw = &m->power[(size_t)w * n];
+    float bin_hz = (float)m->src.rate / n;
+    uint32_t gap = MULTI_GAP_HZ / bin_hz + 1;
+    int32_t spread = MULTI_SPREAD_HZ / bin_hz;
+    float p[n], q[n], sorted[n];
+    uint32_t found = 0;
+
+    // Walk up from the bottom of the band, so channel j is the one
+    // (j - n/2) * bin_hz from the centre
+    for(uint32_t j = 0; j < n; j++)
+        p[j] = raw[(j + n / 2) % n];
+    for(int32_t j = 0; j < (int32_t)n; j++)
+    {
+        int32_t a = j > spread ? j - spread : 0;
+        int32_t b = j + spread < (int32_t)n ? j + spread : (int32_t)n - 1;
+        float sum = 0;
+        for(int32_t k = a; k <= b; k++) sum += p[k];
+        q[j] = sum / (b - a + 1);
+    }
+
+    memcpy(sorted, p, sizeof(sorted));
+    qsort(sorted, n, sizeof(float), multi_cmp_float);
+    float level = sorted[n / 2] * threshold;
+    memcpy(sorted, q, sizeof(sorted));
+    qsort(sorted, n, sizeof(float), multi_cmp_float);
+    float level_q = sorted[n / 2] * threshold;
+
+    int32_t start = -1, end = -1;
+    double sum = 0, moment = 0;
+    for(uint32_t j = 0; j <= n; j++)
+    {
+        float hz = ((float)j - n / 2) * bin_hz;
+        bool on = j < n && (p[j] > level || q[j] > level_q) &&
+            fabsf(hz) >= dc_hz;
+
+        if( start >= 0 && (j == n || j - end > gap) )
+        {
+            if( found < max )
+            {
+                out[found].hz = moment / sum;
+                out[found].power = sum;
+                out[found].width = (end - start + 1) * bin_hz;
+                found++;
+            }
+            start = -1;
+        }
+        if( on )
+        {
+            if( start < 0 )
+            {
+                start = j;
+                sum = moment = 0;
+            }
+            end = j;
+            sum += p[j];
+            moment += p[j] * hz;
+        }
+    }
+    return found;
+}
+
+/**
+ * Follow the signals from window to window, strongest first, starting a
+ * new track for any that are not close to one seen recently.
+ */
+static void multi_track(multi_t* m, float threshold, float dc_hz)
+{
+    double window_s = (double)m->window / m->src.rate;
+    uint32_t hold = MULTI_HOLD / window_s + 1;
+    multi_cluster_t clusters[64];
+
+    for(uint32_t w = 0; w < m->windows; w++)
+    {
+        uint32_t n = multi_detect(m, w, threshold, dc_hz, clusters, 64);
+        qsort(clusters, n, sizeof(multi_cluster_t), multi_cmp_cluster);
+
+        for(uint32_t c = 0; c < n; c++)
+        {
+            multi_track_t* best = NULL;
+            float dist = MULTI_ASSOC_HZ;
+
+            for(uint32_t i = 0; i < m->ntracks; i++)
+            {
+                multi_track_t* t = &m->tracks[i];
+                float d = fabsf(t->last_hz - clusters[c].hz);
+                if( t->last != w && w - t->last <= hold && d < dist )
+                {
+                    best = t;
+                    dist = d;
+                }
+            }
+
+            if( !best )
+            {
+                if( m->ntracks == MULTI_MAX_TRACKS ) continue;
+                best = &m->tracks[m->ntracks++];
+                best->first = w;
+                best->hz = malloc(m->windows * sizeof(float));
+                for(uint32_t i = 0; i < m->windows; i++)
+                    best->hz[i] = NAN;
+            }
+            best->last = w;
+            best->last_hz = clusters[c].hz;
+            best->hz[w] = clusters[c].hz;
+            best->seen++;
+            if( clusters[c].width >= MULTI_AFSK_WIDTH ) best->wide++;
+        }
+    }
+
+    // Drop anything too short to be real and settle what is left
+    uint32_t kept = 0;
+    uint32_t smooth = MULTI_SMOOTH / window_s / 2;
+    for(uint32_t i = 0; i < m->ntracks; i++)
+    {
+        multi_track_t* t = &m->tracks[i];
+        if( t->seen * window_s < MULTI_MIN_LEN )
+        {
+            free(t->hz);
+            continue;
+        }
+
+        if( strcmp(m->mode, "afsk") == 0 ) t->afsk = true;
+        else if( strcmp(m->mode, "fsk") == 0 ) t->afsk = false;
+        else t->afsk = t->wide * 2 > t->seen;
+
+        // Fill the gaps in between sightings, hold the ends, then take
+        // a moving average so the mixer follows drift and not noise
+        float* raw = malloc(m->windows * sizeof(float));
+        uint32_t prev = t->first;
+        for(uint32_t w = t->first + 1; w <= t->last; w++)
+        {
+            if( isnan(t->hz[w]) ) continue;
+            for(uint32_t g = prev + 1; g < w; g++)
+                t->hz[g] = t->hz[prev] + (t->hz[w] - t->hz[prev]) *
+                    (g - prev) / (w - prev);
+            prev = w;
+        }
+        for(uint32_t w = 0; w < m->windows; w++)
+        {
+            uint32_t c = w < t->first ? t->first : w > t->last ? t->last : w;
+            raw[w] = t->hz[c];
+        }
+        for(uint32_t w = 0; w < m->windows; w++)
+        {
+            uint32_t a = w > smooth ? w - smooth : 0;
+            uint32_t b = w + smooth < m->windows ? w + smooth :
+                m->windows - 1;
+            double sum = 0;
+            for(uint32_t k = a; k <= b; k++) sum += raw[k];
+            t->hz[w] = sum / (b - a + 1);
+        }
+        free(raw);
+
+        t->from = t->first > hold ? t->first - hold : 0;
+        t->to = t->last + hold < m->windows ? t->last + hold + 1 :
+            m->windows;
+        m->tracks[kept++] = *t;
+    }
+    m->ntracks = kept;
+}
+
+static void multi_found(rtty_sentence_t* s, void* param)
+{
+    multi_track_t* t = (multi_track_t*)param;
+
+    if( t->count == t->size )
+    {
+        t->size = t->size ? t->size * 2 : 64;
+        t->found = realloc(t->found, t->size * sizeof(*t->found));
+    }
+    t->found[t->count++] = *s;
+}
+
+/**
+ * Score for the tones being either side of bin c, over a spectrum of len
+ * bins h apart.
+ */
+static float multi_fsk_score(const float* p, uint32_t len, int32_t c,
+        int32_t lo, int32_t hi)
+{
+    float a = 0, b = 0;
+    for(int32_t k = -1; k <= 1; k++)
+    {
+        if( p[(c - lo + k) & (len - 1)] > a ) a = p[(c - lo + k) & (len - 1)];
+        if( p[(c + hi + k) & (len - 1)] > b ) b = p[(c + hi + k) & (len - 1)];
+    }
+    return a + b;
+}
+
+/**
+ * The FSK tones are too close together to tell apart in the filterbank,
+ * and where the power sits between them depends on the data, so the
+ * channel is still off by tens of Hz and wandering. Find the pair in the
+ * spectrum of the whole channel, then every MULTI_FSK_SEGMENT seconds
+ * within MULTI_FSK_PULL of that, and mix the channel down again so they
+ * sit either side of 0Hz. Keeping each segment close to the whole
+ * channel stops a run of idle mark being taken for space.
+ */
+static void multi_fsk_tune(float* iq, size_t n, double rate,
+        rtty_config_t* cfg)
+{
+    uint32_t len = 1;
+    while( len < rate * MULTI_FSK_BLOCK ) len <<= 1;
+    uint32_t per = MULTI_FSK_SEGMENT * rate / len;
+    if( per < 1 ) per = 1;
+    size_t segs = n / ((size_t)per * len) + 1;
+
+    fft_t fft;
+    float* re = malloc(len * sizeof(float));
+    float* im = malloc(len * sizeof(float));
+    float* p = calloc(segs * len, sizeof(float));
+    float* all = calloc(len, sizeof(float));
+    double* centre = malloc(segs * sizeof(double));
+    fft_init(&fft, len);
+
+    for(size_t at = 0, b = 0; at + len <= n; at += len, b++)
+    {
+        float* ps = &p[b / per * len];
+        for(uint32_t i = 0; i < len; i++)
+        {
+            float h = 0.5f - 0.5f * cosf(2 * M_PI * i / len);
+            re[i] = iq[2 * (at + i)] * h;
+            im[i] = iq[2 * (at + i) + 1] * h;
+        }
+        fft_run(&fft, re, im);
+        for(uint32_t i = 0; i < len; i++)
+        {
+            ps[i] += re[i] * re[i] + im[i] * im[i];
+            all[i] += re[i] * re[i] + im[i] * im[i];
+        }
+    }
+
+    double bin_hz = rate / len;
+    int32_t lo = MULTI_FSK_SHIFT / 2 / bin_hz + 0.5;
+    int32_t hi = MULTI_FSK_SHIFT / bin_hz + 0.5 - lo;
+    int32_t reach = (MULTI_FSK_CUTOFF - MULTI_FSK_SHIFT / 2) / bin_hz;
+    int32_t pull = MULTI_FSK_PULL / bin_hz;
+    int32_t c0 = 0;
+    float best = -1;
+
+    for(int32_t c = -reach; c <= reach; c++)
+    {
+        float score = multi_fsk_score(all, len, c, lo, hi);
+        if( score > best )
+        {
+            best = score;
+            c0 = c;
+        }
+    }
+    for(size_t s = 0; s < segs; s++)
+    {
+        int32_t cs = c0;
+        best = -1;
+        for(int32_t c = c0 - pull; c <= c0 + pull; c++)
+        {
+            float score = multi_fsk_score(&p[s * len], len, c, lo, hi);
+            if( score > best )
+            {
+                best = score;
+                cs = c;
+            }
+        }
+        centre[s] = cs * bin_hz;
+    }
+
+    // Median of three to throw out the odd bad segment, then mix down by
+    // a centre interpolated between the middles of the segments
+    double* med = malloc(segs * sizeof(double));
+    for(size_t s = 0; s < segs; s++)
+    {
+        double a = centre[s > 0 ? s - 1 : s], b = centre[s];
+        double c = centre[s + 1 < segs ? s + 1 : s];
+        med[s] = a > b ? (b > c ? b : (a > c ? c : a)) :
+            (a > c ? a : (b > c ? c : b));
+    }
+    double span = (double)per * len, phase = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        double x = i / span - 0.5;
+        size_t s = x < 0 ? 0 : (size_t)x;
+        double hz = s + 1 < segs ? med[s] + (med[s + 1] - med[s]) *
+            (x < 0 ? 0 : x - s) : med[segs - 1];
+        float c = cos(phase), sn = sin(phase);
+        float r = iq[2 * i], q = iq[2 * i + 1];
+        iq[2 * i] = r * c + q * sn;
+        iq[2 * i + 1] = q * c - r * sn;
+        phase = fmod(phase + 2 * M_PI * hz / rate, 2 * M_PI);
+    }
+
+    cfg->space = -MULTI_FSK_SHIFT / 2;
+    cfg->mark = MULTI_FSK_SHIFT / 2;
+
+    fft_free(&fft);
+    free(re);
+    free(im);
+    free(p);
+    free(all);
+    free(centre);
+    free(med);
+}
+
+/**
+ * Pull one track out of the recording and demodulate it.
+ */
+static void multi_decode(multi_t* m, multi_track_t* t)
+{
+    uint32_t rate = m->src.rate;
+    uint32_t decim = rate / (t->afsk ? MULTI_AFSK_RATE : MULTI_FSK_RATE);
+    float cutoff = t->afsk ? MULTI_AFSK_CUTOFF : MULTI_FSK_CUTOFF;
+    if( decim < 1 ) decim = 1;
+    if( cutoff > 0.45f * rate / decim ) cutoff = 0.45f * rate / decim;
+
+    size_t windows = t->to - t->from;
+    size_t max = windows * (m->window / decim + 1);
+    float* iq = malloc(max * 2 * sizeof(float));
+    size_t n = 0;
+
+    ddc_t ddc;
+    ddc_init(&ddc, rate, cutoff, decim);
+    for(uint32_t w = t->from; w < t->to; w++)
+        n += ddc_run(&ddc, &m->src, w * m->window, m->window, t->hz[w],
+                &iq[2 * n]);
+    ddc_free(&ddc);
+
+    source_t chan;
+    rtty_config_t cfg = m->cfg;
+    t->rate = (double)rate / decim;
+
+    if( t->afsk )
+    {
+        // FM discriminator, then average down to the audio rate
+        uint32_t avg = t->rate / MULTI_AUDIO_RATE;
+        if( avg < 1 ) avg = 1;
+        size_t len = n / avg;
+        float* audio = malloc((len + 1) * sizeof(float));
+        float pr = 0, pi = 0;
+
+        for(size_t k = 0; k < len; k++)
+        {
+            float sum = 0;
+            for(uint32_t j = 0; j < avg; j++)
+            {
+                float r = iq[2 * (k * avg + j)], i = iq[2 * (k * avg + j) + 1];
+                sum += atan2f(i * pr - r * pi, r * pr + i * pi);
+                pr = r;
+                pi = i;
+            }
+            audio[k] = sum / avg;
+        }
+        free(iq);
+        iq = audio;
+        n = len;
+        t->rate /= avg;
+
+        cfg.mark = MULTI_AFSK_MARK;
+        cfg.space = MULTI_AFSK_SPACE;
+        source_memory(&chan, audio, n, t->rate + 0.5, 1, false);
+    }
+    else
+    {
+        multi_fsk_tune(iq, n, t->rate, &cfg);
+        source_memory(&chan, iq, n, t->rate + 0.5, 2, true);
+    }
+
+    rtty_decode(&chan, &cfg, 0, n, multi_found, t);
+    free(iq);
+}
+
+static void* multi_decode_thread(void* param)
+{
+    multi_t* m = (multi_t*)param;
+    uint32_t i;
+
+    while( (i = __sync_fetch_and_add(&m->next, 1)) < m->ntracks )
+        multi_decode(m, &m->tracks[i]);
+    return NULL;
+}
+
+/**
+ * A sentence and where it came from, for printing in time order
+ */
+typedef struct
+{
+    double at;
+    float hz;
+    rtty_sentence_t* s;
+} multi_line_t;
+
+static int multi_cmp_line(const void* a, const void* b)
+{
+    const multi_line_t* x = a;
+    const multi_line_t* y = b;
+    if( x->at != y->at ) return x->at < y->at ? -1 : 1;
+    return x->hz < y->hz ? -1 : x->hz > y->hz;
+}
+
+static double multi_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-r rate] [-i] [-F hz] [-b baud] "
+            "[-m afsk|fsk] [-c hz] [-w seconds] [-T db] [-d hz] "
+            "[-t threads] [-a] [-v] recording\n", name);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    static multi_t m;
+    uint32_t rate = 250000;
+    double centre = 0, window_s = 0.5;
+    float channel_hz = 500, threshold_db = 3, dc_hz = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool all = false, verbose = false;
+    int opt;
+
+    m.cfg.baud = 50;
+    m.mode = "auto";
+
+    while( (opt = getopt(argc, argv, "r:iF:b:m:c:w:T:d:t:av")) != -1 )
+    {
+        switch(opt)
+        {
+            case 'r': rate = atoi(optarg); break;
+            case 'i': break;
+            case 'F': centre = atof(optarg); break;
+            case 'b': m.cfg.baud = atof(optarg); break;
+            case 'm': m.mode = optarg; break;
+            case 'c': channel_hz = atof(optarg); break;
+            case 'w': window_s = atof(optarg); break;
+            case 'T': threshold_db = atof(optarg); break;
+            case 'd': dc_hz = atof(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'a': all = true; break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if( optind != argc - 1 || m.cfg.baud <= 0 || channel_hz <= 0 ||
+            window_s <= 0 )
+        usage(argv[0]);
+    if( strcmp(m.mode, "auto") && strcmp(m.mode, "afsk") &&
+            strcmp(m.mode, "fsk") )
+        usage(argv[0]);
+
+    if( source_open(&m.src, argv[optind], rate, true) != 0 )
+    {
+        fprintf(stderr, "%s: cannot read\n", argv[optind]);
+        return 1;
+    }
+    if( !m.src.iq )
+    {
+        fprintf(stderr, "%s: needs an IQ recording\n", argv[optind]);
+        return 1;
+    }
+
+    m.channels = 2;
+    while( (float)m.src.rate / m.channels > channel_hz ) m.channels <<= 1;
+    m.frames = window_s * m.src.rate / m.channels + 0.5;
+    if( m.frames < 1 ) m.frames = 1;
+    m.window = (size_t)m.frames * m.channels;
+    m.windows = (m.src.samples + m.window - 1) / m.window;
+    m.power = calloc((size_t)m.windows * m.channels, sizeof(float));
+
+    if( threads < 1 ) threads = 1;
+    if( threads > MULTI_MAX_THREADS ) threads = MULTI_MAX_THREADS;
+    if( threads > m.windows ) threads = m.windows;
+    double t0 = multi_now();
+
+    // Spectra, a share of the windows each
+    multi_job_t* jobs = calloc(threads, sizeof(multi_job_t));
+    for(long i = 0; i < threads; i++)
+    {
+        jobs[i].m = &m;
+        jobs[i].from = (uint64_t)m.windows * i / threads;
+        jobs[i].to = (uint64_t)m.windows * (i + 1) / threads;
+        pthread_create(&jobs[i].thread, NULL, multi_spectrum_thread,
+                &jobs[i]);
+    }
+    for(long i = 0; i < threads; i++)
+        pthread_join(jobs[i].thread, NULL);
+    free(jobs);
+    double t1 = multi_now();
+
+    multi_track(&m, powf(10, threshold_db / 10), dc_hz);
+    if( verbose )
+    {
+        for(uint32_t i = 0; i < m.ntracks; i++)
+        {
+            multi_track_t* t = &m.tracks[i];
+            fprintf(stderr, centre ? "signal %u: %.0f Hz %s, %.1f to "
+                    "%.1f s\n" : "signal %u: %+.0f Hz %s, %.1f to %.1f s\n",
+                    i, centre + t->hz[t->first], t->afsk ? "AFSK" : "FSK",
+                    (double)t->first * m.window / m.src.rate,
+                    (double)(t->last + 1) * m.window / m.src.rate);
+        }
+    }
+
+    // Demodulate, a signal at a time each
+    long workers = threads < (long)m.ntracks ? threads : (long)m.ntracks;
+    pthread_t pool[MULTI_MAX_THREADS];
+    for(long i = 0; i < workers; i++)
+        pthread_create(&pool[i], NULL, multi_decode_thread, &m);
+    for(long i = 0; i < workers; i++)
+        pthread_join(pool[i], NULL);
+
+    size_t total = 0, good = 0, bad = 0;
+    for(uint32_t i = 0; i < m.ntracks; i++) total += m.tracks[i].count;
+    multi_line_t* lines = malloc((total + 1) * sizeof(multi_line_t));
+    total = 0;
+    for(uint32_t i = 0; i < m.ntracks; i++)
+    {
+        multi_track_t* t = &m.tracks[i];
+        for(size_t j = 0; j < t->count; j++)
+        {
+            rtty_sentence_t* s = &t->found[j];
+            double at = (double)t->from * m.window / m.src.rate +
+                s->at / t->rate;
+            uint32_t w = at * m.src.rate / m.window;
+            if( w >= m.windows ) w = m.windows - 1;
+
+            if( s->crc_ok ) good++;
+            else bad++;
+            if( !s->crc_ok && !all ) continue;
+            lines[total].at = at;
+            lines[total].hz = t->hz[w];
+            lines[total].s = s;
+            total++;
+        }
+    }
+    qsort(lines, total, sizeof(multi_line_t), multi_cmp_line);
+    for(size_t i = 0; i < total; i++)
+        printf(centre ? "%10.3f %12.0f %s %s\n" : "%10.3f %+12.0f %s %s\n",
+                lines[i].at,
+                centre + lines[i].hz, lines[i].s->crc_ok ? "OK " : "BAD",
+                lines[i].s->text);
+
+    double t2 = multi_now();
+    double length = (double)m.src.samples / m.src.rate;
+    fprintf(stderr, "%u signals, %zu good, %zu bad sentences in %.1f s of "
+            "recording at %u Hz, %.2f s searching and %.2f s decoding on "
+            "%ld threads, %.0fx real time\n", m.ntracks, good, bad, length,
+            m.src.rate, t1 - t0, t2 - t1, threads, length / (t2 - t0));
+
+    for(uint32_t i = 0; i < m.ntracks; i++)
+    {
+        free(m.tracks[i].hz);
+        free(m.tracks[i].found);
+    }
+    free(lines);
+    free(m.power);
+    source_close(&m.src);
+    return 0;
+}
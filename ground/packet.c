@@ -0,0 +1,250 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <string.h>
+#include <math.h>
+#include "packet.h"
+#include "msgpack.h"
+
+/**
+ * How well the sync word matches at soft bit at, the cosine of the angle
+ * between them, so 1 for a perfect match and -1 for an inverted one.
+ */
+static float _packet_sync(const float* soft, size_t at)
+{
+    float corr = 0, mag = 0;
+
+    for(int i = 0; i < PACKET_SYNC_BITS; i++)
+    {
+        float x = soft[at + i];
+        corr += PACKET_SYNC >> (PACKET_SYNC_BITS - 1 - i) & 1 ? x : -x;
+        mag += x * x;
+    }
+    return mag > 0 ? corr / sqrtf(mag * PACKET_SYNC_BITS) : 0;
+}
+
+/**
+ * Look for the sync word from soft bit from onwards, with room for a
+ * whole frame after it. Near the sensitivity of the code 32 bits are
+ * not enough to find a frame on their own, so this returns candidates:
+ * the best match of either sign within a sync word of the first to
+ * reach threshold. Returns where it starts and sets its score, or n if
+ * there is none.
+ */
+size_t packet_find(const float* soft, size_t n, size_t from,
+        float threshold, float* score)
+{
+    size_t frame = PACKET_SYNC_BITS + 3 * TURBO_K_376 + 4 * TURBO_TAIL;
+
+    for(size_t at = from; at + frame <= n; at++)
+    {
+        float s = _packet_sync(soft, at);
+        if( fabsf(s) < threshold ) continue;
+
+        size_t best = at;
+        for(size_t i = at + 1; i < at + PACKET_SYNC_BITS &&
+                i + frame <= n; i++)
+        {
+            float t = _packet_sync(soft, i);
+            if( fabsf(t) > fabsf(s) )
+            {
+                s = t;
+                best = i;
+            }
+        }
+        *score = s;
+        return best;
+    }
+    return n;
+}
+
+/**
+ * Decode the frame whose coded bits start at soft, and unpack it. An
+ * inverted frame is decoded the right way up.
+ */
+void packet_decode(turbo_t* turbo, const float* soft, int iterations,
+        packet_t* p)
+{
+    uint16_t bits = turbo_coded_bits(turbo);
+    float llr[bits];
+    uint8_t coded[(bits + 7) / 8];
+
+    p->inverted = p->sync < 0;
+    for(uint16_t i = 0; i < bits; i++)
+        llr[i] = p->inverted ? -soft[i] : soft[i];
+
+    p->iterations = turbo_decode(turbo, llr, p->payload, iterations);
+
+    // Encode what we got to see how much of the channel it disagrees with
+    turbo_encode(turbo, p->payload, coded);
+    p->corrected = 0;
+    for(uint16_t i = 0; i < bits; i++)
+        if( (coded[i >> 3] >> (7 - (i & 7)) & 1) != (llr[i] > 0) )
+            p->corrected++;
+
+    p->ok = packet_unpack(p->payload, PACKET_BYTES, p);
+}
+
+/**
+ * One varint off the history, seven bits a byte least significant
+ * first. Returns false if it runs off the end.
+ */
+static bool _packet_varint(const uint8_t** p, const uint8_t* end,
+        uint32_t* v)
+{
+    *v = 0;
+    for(int shift = 0; *p < end && shift < 35; shift += 7)
+    {
+        uint8_t b = *(*p)++;
+        *v |= (uint32_t)(b & 0x7F) << shift;
+        if( !(b & 0x80) ) return true;
+    }
+    return false;
+}
+
+static int32_t _packet_unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * Rebuild the older fixes from their deltas, each taken from the one
+ * after it starting at the frame's own position and time.
+ */
+static bool _packet_history(const uint8_t* b, uint32_t len, packet_t* p)
+{
+    const uint8_t* end = b + len;
+    uint32_t time = p->time;
+    int32_t lat = p->lat, lon = p->lon, alt = p->alt;
+    uint32_t v[4];
+
+    p->history = 0;
+    while( b < end && p->history < PACKET_HISTORY )
+    {
+        for(int i = 0; i < 4; i++)
+            if( !_packet_varint(&b, end, &v[i]) ) return false;
+
+        time = (time + 86400 - v[0] % 86400) % 86400;
+        lat += _packet_unzigzag(v[1]) * PACKET_HISTORY_STEP;
+        lon += _packet_unzigzag(v[2]) * PACKET_HISTORY_STEP;
+        alt += _packet_unzigzag(v[3]);
+
+        packet_fix_t* f = &p->fixes[p->history++];
+        f->time = time;
+        f->lat = lat;
+        f->lon = lon;
+        f->alt = alt;
+    }
+    return b == end;
+}
+
+/**
+ * CRC-16/CCITT-FALSE, as _crc_xmodem_update() from 0xFFFF gives in the
+ * firmware.
+ */
+static uint16_t _packet_crc(const uint8_t* buf, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)buf[i] << 8;
+        for(int b = 0; b < 8; b++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+/**
+ * Check the CRC on the end of a payload, then read the telemetry map
+ * out of the rest. Keys we do not know are skipped. Returns true if the
+ * CRC matched and it was a map with an id and a tick.
+ */
+bool packet_unpack(const uint8_t* buf, size_t len, packet_t* p)
+{
+    msgpack_t m;
+    uint32_t n, items;
+    int64_t key, v[3];
+    const char* s;
+    const uint8_t* history = NULL;
+    uint32_t history_len = 0;
+
+    p->have = 0;
+    p->history = 0;
+    if( len < PACKET_CRC_BYTES ) return false;
+    len -= PACKET_CRC_BYTES;
+    if( _packet_crc(buf, len) != (buf[len] << 8 | buf[len + 1]) )
+        return false;
+
+    msgpack_init(&m, buf, len);
+    if( !msgpack_read_map(&m, &n) ) return false;
+
+    while( n-- )
+    {
+        if( !msgpack_read_int(&m, &key) ) return false;
+
+        switch(key)
+        {
+            case PACKET_KEY_ID:
+                if( !msgpack_read_str(&m, &s, &items) ) return false;
+                if( items >= sizeof(p->id) ) items = sizeof(p->id) - 1;
+                memcpy(p->id, s, items);
+                p->id[items] = '\0';
+                break;
+
+            case PACKET_KEY_TICK:
+                if( !msgpack_read_int(&m, &v[0]) ) return false;
+                p->tick = v[0];
+                break;
+
+            case PACKET_KEY_TIME:
+                if( !msgpack_read_int(&m, &v[0]) ) return false;
+                p->time = v[0];
+                break;
+
+            case PACKET_KEY_POSITION:
+                if( !msgpack_read_array(&m, &items) || items != 3 )
+                    return false;
+                for(int i = 0; i < 3; i++)
+                    if( !msgpack_read_int(&m, &v[i]) ) return false;
+                p->lat = v[0];
+                p->lon = v[1];
+                p->alt = v[2];
+                break;
+
+            case PACKET_KEY_SATS:
+                if( !msgpack_read_int(&m, &v[0]) ) return false;
+                p->sats = v[0];
+                break;
+
+            case PACKET_KEY_LOCK:
+                if( !msgpack_read_int(&m, &v[0]) ) return false;
+                p->lock = v[0];
+                break;
+
+            case PACKET_KEY_HISTORY:
+                if( !msgpack_read_bin(&m, &history, &history_len) )
+                    return false;
+                break;
+
+            default:
+                if( !msgpack_skip(&m) ) return false;
+                continue;
+        }
+        if( key < 8 ) p->have |= 1 << key;
+    }
+
+    // The history hangs off the position and time, wherever they were
+    if( history && (p->have & (1 << PACKET_KEY_POSITION)) &&
+            (p->have & (1 << PACKET_KEY_TIME)) &&
+            !_packet_history(history, history_len, p) )
+        return false;
+
+    return (p->have & (1 << PACKET_KEY_ID)) &&
+        (p->have & (1 << PACKET_KEY_TICK));
+}
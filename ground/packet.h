@@ -0,0 +1,84 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __PACKET_H__
+#define __PACKET_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "turbo.h"
+
+// Every binary frame starts with this, see RADIO_BINARY_SYNC
+#define PACKET_SYNC         0x1ACFFC1DUL
+#define PACKET_SYNC_BITS    32
+
+// MessagePack the payload carries, TURBO_K_376 bits of it. The last
+// PACKET_CRC_BYTES are the CRC-16 of the rest, big endian.
+#define PACKET_BYTES        (TURBO_K_376 / 8)
+#define PACKET_CRC_BYTES    2
+
+// Keys of the telemetry map, as written by build_binary_frame()
+#define PACKET_KEY_ID       0
+#define PACKET_KEY_TICK     1
+#define PACKET_KEY_TIME     2
+#define PACKET_KEY_POSITION 3
+#define PACKET_KEY_SATS     4
+#define PACKET_KEY_LOCK     5
+#define PACKET_KEY_HISTORY  6
+
+// Older fixes a frame can carry, and the 1e-7 degrees one step of their
+// latitude and longitude deltas is worth, see HISTORY_STEP
+#define PACKET_HISTORY      16
+#define PACKET_HISTORY_STEP 100
+
+/**
+ * A fix from before the one the frame was sent with
+ */
+typedef struct
+{
+    uint32_t time;          // seconds into the day
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;
+    int32_t alt;            // m
+} packet_fix_t;
+
+/**
+ * A binary frame as it came off the air, and what was in it
+ */
+typedef struct
+{
+    size_t at;              // soft bit the sync word started on
+    float sync;             // how well it matched, see packet_find()
+    bool inverted;          // the demodulator had mark and space swapped
+    int iterations;
+    uint16_t corrected;     // coded bits the decoder overruled
+    bool ok;                // unpacked into a telemetry map
+    uint8_t have;           // bit n set if key n was present
+
+    char id[16];
+    uint32_t tick;
+    uint32_t time;          // seconds into the day
+    int32_t lat;            // 1e-7 degrees
+    int32_t lon;
+    int32_t alt;            // m
+    uint8_t sats;
+    uint8_t lock;
+    uint8_t history;        // fixes in fixes[], newest first
+    packet_fix_t fixes[PACKET_HISTORY];
+
+    uint8_t payload[PACKET_BYTES];
+} packet_t;
+
+size_t packet_find(const float* soft, size_t n, size_t from,
+        float threshold, float* score);
+void packet_decode(turbo_t* turbo, const float* soft, int iterations,
+        packet_t* p);
+bool packet_unpack(const uint8_t* buf, size_t len, packet_t* p);
+
+#endif /* __PACKET_H__ */
@@ -0,0 +1,109 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pfb.h"
+
+/**
+ * Set up M channels, able to work on up to frames outputs per call to
+ * pfb_power(). The prototype is a Hamming windowed sinc one channel
+ * wide. Returns 0 on success.
+ */
+int pfb_init(pfb_t* pfb, uint32_t channels, uint32_t frames)
+{
+    uint32_t len = channels * PFB_TAPS;
+
+    memset(pfb, 0, sizeof(*pfb));
+    if( fft_init(&pfb->fft, channels) != 0 ) return -1;
+
+    pfb->channels = channels;
+    pfb->window = malloc(len * sizeof(float));
+    pfb->buf_len = (size_t)(frames + PFB_TAPS - 1) * channels;
+    pfb->buf = malloc(pfb->buf_len * 2 * sizeof(float));
+    pfb->re = malloc(channels * sizeof(float));
+    pfb->im = malloc(channels * sizeof(float));
+
+    for(uint32_t n = 0; n < len; n++)
+    {
+        double x = ((double)n - (len - 1) / 2.0) / channels;
+        double sinc = x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+        pfb->window[n] = sinc * (0.54 - 0.46 * cos(2 * M_PI * n / (len - 1)));
+    }
+    return 0;
+}
+
+/**
+ * Add the power in each channel of frames outputs, the first ending at
+ * sample start + M, into power[M]. Channels are in FFT order, so those
+ * from M/2 up are below the centre of the recording.
+ */
+void pfb_power(pfb_t* pfb, source_t* src, size_t start, uint32_t frames,
+        float* power)
+{
+    uint32_t m = pfb->channels;
+    size_t history = (size_t)(PFB_TAPS - 1) * m;
+    size_t len = (size_t)(frames + PFB_TAPS - 1) * m;
+    float* re = pfb->buf;
+    float* im = pfb->buf + pfb->buf_len;
+    size_t skip = 0;
+
+    // The first frames of a recording look back before its start
+    if( start < history )
+    {
+        skip = history - start;
+        memset(re, 0, skip * sizeof(float));
+        memset(im, 0, skip * sizeof(float));
+    }
+    source_read(src, start + skip - history, len - skip, re + skip,
+            im + skip);
+
+    for(uint32_t f = 0; f < frames; f++)
+    {
+        const float* xr = re + (size_t)f * m;
+        const float* xi = im + (size_t)f * m;
+
+        // Fold the windowed input onto one branch per channel
+        memset(pfb->re, 0, m * sizeof(float));
+        memset(pfb->im, 0, m * sizeof(float));
+        for(uint32_t t = 0; t < PFB_TAPS; t++)
+        {
+            const float* h = pfb->window + t * m;
+            for(uint32_t p = 0; p < m; p++)
+            {
+                pfb->re[p] += xr[t * m + p] * h[p];
+                pfb->im[p] += xi[t * m + p] * h[p];
+            }
+        }
+
+        fft_run(&pfb->fft, pfb->re, pfb->im);
+        for(uint32_t k = 0; k < m; k++)
+            power[k] += pfb->re[k] * pfb->re[k] + pfb->im[k] * pfb->im[k];
+    }
+}
+
+/**
+ * Frequency of the centre of a channel, relative to the centre of the
+ * recording.
+ */
+float pfb_bin_hz(pfb_t* pfb, uint32_t rate, uint32_t bin)
+{
+    int32_t k = bin < pfb->channels / 2 ? (int32_t)bin :
+        (int32_t)bin - (int32_t)pfb->channels;
+    return (float)k * rate / pfb->channels;
+}
+
+void pfb_free(pfb_t* pfb)
+{
+    fft_free(&pfb->fft);
+    free(pfb->window);
+    free(pfb->buf);
+    free(pfb->re);
+    free(pfb->im);
+}
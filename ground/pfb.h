@@ -0,0 +1,40 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __PFB_H__
+#define __PFB_H__
+
+#include <stdint.h>
+#include "fft.h"
+#include "source.h"
+
+// Taps per branch of the prototype filter
+#define PFB_TAPS        8
+
+/**
+ * Critically sampled polyphase FFT filterbank, a new set of channels
+ * every M input samples.
+ */
+typedef struct
+{
+    uint32_t channels;      // M, a power of two
+    float* window;          // prototype filter, M * PFB_TAPS long
+    float* buf;             // input being worked on, I/Q interleaved
+    size_t buf_len;
+    float* re;
+    float* im;
+    fft_t fft;
+} pfb_t;
+
+int pfb_init(pfb_t* pfb, uint32_t channels, uint32_t frames);
+void pfb_power(pfb_t* pfb, source_t* src, size_t start, uint32_t frames,
+        float* power);
+float pfb_bin_hz(pfb_t* pfb, uint32_t rate, uint32_t bin);
+void pfb_free(pfb_t* pfb);
+
+#endif /* __PFB_H__ */
@@ -0,0 +1,280 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+/**
+ * Decode the flight recorder from a copy of the EEPROM. Usage:
+ *
+ *     recorder [-a address] eeprom.hex
+ *
+ *     -a address   where recorder_log starts in the EEPROM, by default
+ *                  wherever the most records check out
+ *
+ * The input is Intel hex as avrdude reads it back with
+ * -U eeprom:r:eeprom.hex:i, or a raw image. Fixes are printed oldest
+ * first, one a line. A fix whose position depends on a record that was
+ * overwritten or lost has its position left out.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+// Layout of the log, see firmware/recorder.h
+#define RECORDER_LEN        48
+#define RECORDER_SIZE       16
+#define RECORDER_LOCK       0x07
+#define RECORDER_TIME_HI    0x40
+#define RECORDER_KEY        0x80
+#define RECORDER_SEED       0x5A
+#define RECORDER_STEP       100     // HISTORY_STEP
+
+#define RECORDER_EEPROM     1024
+
+static uint16_t recorder_u16(const uint8_t* p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static int32_t recorder_i32(const uint8_t* p)
+{
+    return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+            (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+/**
+ * The check byte is the CRC-8 (polynomial 0x07) of the rest, seeded so
+ * blank EEPROM and the counter ring do not pass.
+ */
+static bool recorder_valid(const uint8_t* r)
+{
+    uint8_t crc = RECORDER_SEED;
+
+    for(int i = 0; i < RECORDER_SIZE - 1; i++)
+    {
+        crc ^= r[i];
+        for(int j = 0; j < 8; j++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc == r[RECORDER_SIZE - 1];
+}
+
+static int recorder_hex(const char* s, int digits)
+{
+    int v = 0;
+
+    for(int i = 0; i < digits; i++)
+    {
+        char c = s[i];
+        v <<= 4;
+        if( c >= '0' && c <= '9' ) v |= c - '0';
+        else if( c >= 'A' && c <= 'F' ) v |= c - 'A' + 10;
+        else if( c >= 'a' && c <= 'f' ) v |= c - 'a' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+/**
+ * Fill the image from Intel hex, checking each line's checksum. Returns
+ * false if the file is not good hex.
+ */
+static bool recorder_read_hex(FILE* f, uint8_t* image)
+{
+    char line[600];
+    uint32_t base = 0;
+
+    while( fgets(line, sizeof(line), f) )
+    {
+        if( line[0] != ':' ) continue;
+
+        int len = recorder_hex(line + 1, 2);
+        if( len < 0 || (int)strlen(line) < 11 + 2 * len ) return false;
+
+        uint8_t sum = 0;
+        for(int i = 0; i < len + 5; i++)
+        {
+            int b = recorder_hex(line + 1 + 2 * i, 2);
+            if( b < 0 ) return false;
+            sum += b;
+        }
+        if( sum ) return false;
+
+        uint16_t addr = recorder_hex(line + 3, 4);
+        int type = recorder_hex(line + 7, 2);
+        const char* data = line + 9;
+
+        switch(type)
+        {
+            case 0x00:
+                for(int i = 0; i < len; i++)
+                {
+                    uint32_t a = base + addr + i;
+                    if( a < RECORDER_EEPROM )
+                        image[a] = recorder_hex(data + 2 * i, 2);
+                }
+                break;
+            case 0x01:
+                return true;
+            case 0x02:
+                base = (uint32_t)recorder_hex(data, 4) << 4;
+                break;
+            case 0x04:
+                base = (uint32_t)recorder_hex(data, 4) << 16;
+                break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Records that check out if the log started at base.
+ */
+static int recorder_count(const uint8_t* image, int base)
+{
+    int n = 0;
+
+    for(int i = 0; i < RECORDER_LEN; i++)
+        n += recorder_valid(image + base + i * RECORDER_SIZE);
+    return n;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-a address] eeprom.hex\n", name);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    static uint8_t image[RECORDER_EEPROM];
+    int last = RECORDER_EEPROM - RECORDER_LEN * RECORDER_SIZE;
+    int base = -1;
+    int opt;
+
+    while( (opt = getopt(argc, argv, "a:")) != -1 )
+    {
+        switch(opt)
+        {
+            case 'a': base = strtol(optarg, NULL, 0); break;
+            default: usage(argv[0]);
+        }
+    }
+    if( optind != argc - 1 || base > last ) usage(argv[0]);
+
+    FILE* f = fopen(argv[optind], "rb");
+    if( !f )
+    {
+        fprintf(stderr, "%s: cannot read\n", argv[optind]);
+        return 1;
+    }
+
+    // Hex if it looks like hex, otherwise the image itself
+    memset(image, 0xFF, sizeof(image));
+    int c = fgetc(f);
+    ungetc(c, f);
+    bool ok = c == ':' ? recorder_read_hex(f, image) :
+        fread(image, 1, sizeof(image), f) > 0;
+    fclose(f);
+    if( !ok )
+    {
+        fprintf(stderr, "%s: not Intel hex or an EEPROM image\n",
+                argv[optind]);
+        return 1;
+    }
+
+    if( base < 0 )
+    {
+        int best = 0;
+        for(int b = 0; b <= last; b++)
+        {
+            int n = recorder_count(image, b);
+            if( n > best )
+            {
+                best = n;
+                base = b;
+            }
+        }
+        if( base < 0 )
+        {
+            fprintf(stderr, "%s: no records\n", argv[optind]);
+            return 1;
+        }
+    }
+    const uint8_t* log = image + base;
+
+    // The newest record is the last of a run of rising sequence numbers,
+    // so the oldest is the one after it
+    int newest = -1;
+    for(int i = 0; i < RECORDER_LEN && newest < 0; i++)
+    {
+        const uint8_t* r = log + i * RECORDER_SIZE;
+        const uint8_t* next = log + (i + 1) % RECORDER_LEN * RECORDER_SIZE;
+        if( !recorder_valid(r) ) continue;
+        if( recorder_valid(next) && next[0] == (uint8_t)(r[0] + 1) )
+            continue;
+        newest = i;
+    }
+
+    int fixes = 0, keys = 0, placed = 0;
+    bool have_ref = false, have_seq = false;
+    uint8_t seq = 0;
+    int32_t lat = 0, lon = 0;
+
+    for(int i = 1; newest >= 0 && i <= RECORDER_LEN; i++)
+    {
+        const uint8_t* r = log + (newest + i) % RECORDER_LEN * RECORDER_SIZE;
+        if( !recorder_valid(r) ) continue;
+
+        // A record missing in between breaks the chain of deltas
+        if( have_seq && r[0] != (uint8_t)(seq + 1) ) have_ref = false;
+        seq = r[0];
+        have_seq = true;
+
+        uint8_t flags = r[1];
+        uint16_t tick = recorder_u16(r + 2);
+
+        if( flags & RECORDER_KEY )
+        {
+            lat = recorder_i32(r + 4);
+            lon = recorder_i32(r + 8);
+            have_ref = true;
+            keys++;
+            continue;
+        }
+
+        uint32_t time = recorder_u16(r + 4) |
+            (flags & RECORDER_TIME_HI ? 0x10000 : 0);
+        uint16_t alt = recorder_u16(r + 6);
+        int16_t dlat = recorder_u16(r + 8);
+        int16_t dlon = recorder_u16(r + 10);
+        int16_t temperature = recorder_u16(r + 12);
+        uint8_t sats = r[14];
+
+        printf("%3u tick %5u %02u:%02u:%02u ", seq, tick, time / 3600,
+                time / 60 % 60, time % 60);
+        if( have_ref )
+        {
+            lat += dlat * RECORDER_STEP;
+            lon += dlon * RECORDER_STEP;
+            printf("%.7f %.7f", lat * 1e-7, lon * 1e-7);
+            placed++;
+        }
+        else
+            printf("%10s %11s", "?", "?");
+        printf(" %u m, %u sats, lock %u, %.1f C\n", alt, sats,
+                flags & RECORDER_LOCK, temperature / 16.0);
+        fixes++;
+    }
+
+    fprintf(stderr, "%d fixes, %d placed, %d keys, log at 0x%03x\n", fixes,
+            placed, keys, base);
+    return 0;
+}
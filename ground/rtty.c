@@ -0,0 +1,242 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rtty.h"
+#include "ukhas.h"
+
+// States of the character decoder
+#define RTTY_IDLE       0
+#define RTTY_BITS       1
+
+// 7N2: start bit, 7 data bits LSB first, then the stop bits
+#define RTTY_DATA_BITS  7
+
+typedef float v8f __attribute__((vector_size(32)));
+typedef double v4d __attribute__((vector_size(32)));
+
+/**
+ * Decoder state for one run over part of a recording
+ */
+typedef struct
+{
+    uint32_t bit_len;       // samples per bit
+    double omega[2];        // mark then space, radians per sample
+
+    // Last bit_len mixer outputs and their running sum, lanes are mark
+    // I, mark Q, space I, space Q
+    v4d* hist;
+    uint32_t hist_ptr;
+    v4d acc;
+
+    uint8_t state;
+    float prev;
+    size_t next;            // sample to decide the next bit on
+    size_t char_at;
+    uint8_t bit;
+    uint8_t c;
+
+    rtty_sentence_t sentence;
+    size_t keep_from;
+    size_t keep_to;
+    rtty_sentence_cb cb;
+    void* param;
+} rtty_t;
+
+/**
+ * Allocate zeroed memory aligned for the vector types.
+ */
+static void* _rtty_alloc(size_t len)
+{
+    void* p = NULL;
+    if( posix_memalign(&p, 32, len) != 0 ) abort();
+    memset(p, 0, len);
+    return p;
+}
+
+/**
+ * How far before and after its own part of a recording a run has to
+ * look so that no sentence is lost at the join.
+ */
+size_t rtty_margin(source_t* src, rtty_config_t* cfg)
+{
+    size_t bit_len = src->rate / cfg->baud + 0.5;
+    return (RTTY_MAX_SENTENCE + 2) * (RTTY_DATA_BITS + 3) * bit_len;
+}
+
+/**
+ * Mix a block down by both tones, e^-j(omega)n for samples n0 onwards,
+ * eight samples at a time. The oscillators are rotated rather than
+ * evaluated and restarted each block so they do not drift.
+ */
+static void _rtty_mix(rtty_t* r, size_t n0, const float* re,
+        const float* im, float out[4][RTTY_BLOCK])
+{
+    for(int k = 0; k < 2; k++)
+    {
+        double w = r->omega[k];
+        v8f c, s;
+
+        for(int l = 0; l < 8; l++)
+        {
+            double ph = fmod(w * (double)(n0 + l), 2 * M_PI);
+            c[l] = cos(ph);
+            s[l] = sin(ph);
+        }
+        float cr = cos(8 * w), sr = sin(8 * w);
+
+        for(int i = 0; i < RTTY_BLOCK; i += 8)
+        {
+            v8f xr, xi;
+            memcpy(&xr, &re[i], sizeof(xr));
+            memcpy(&xi, &im[i], sizeof(xi));
+
+            v8f mi = xr * c + xi * s;
+            v8f mq = xi * c - xr * s;
+            memcpy(&out[2 * k][i], &mi, sizeof(mi));
+            memcpy(&out[2 * k + 1][i], &mq, sizeof(mq));
+
+            v8f nc = c * cr - s * sr;
+            s = s * cr + c * sr;
+            c = nc;
+        }
+    }
+}
+
+/**
+ * A character has come in, build sentences out of them. A $ following
+ * anything but another $ starts a new sentence, so we resync quickly.
+ */
+static void _rtty_char(rtty_t* r, uint8_t c)
+{
+    rtty_sentence_t* s = &r->sentence;
+
+    if( c == '$' )
+    {
+        if( s->len == 0 || s->text[s->len - 1] != '$' )
+        {
+            s->len = 0;
+            s->at = r->char_at;
+        }
+    }
+    else if( s->len == 0 )
+    {
+        return;
+    }
+    else if( c == '\n' )
+    {
+        s->text[s->len] = '\0';
+        s->crc_ok = ukhas_verify(s->text, s->len);
+        if( s->at >= r->keep_from && s->at < r->keep_to )
+            r->cb(s, r->param);
+        s->len = 0;
+        return;
+    }
+    else if( c < 0x20 || c > 0x7E || s->len >= RTTY_MAX_SENTENCE )
+    {
+        s->len = 0;
+        return;
+    }
+    s->text[s->len++] = c;
+}
+
+/**
+ * Run the asynchronous character decoder on one sample of mark minus
+ * space power. The filter output crosses zero half a bit into the start
+ * bit, and each bit is decided when the filter lines up with it.
+ */
+static void _rtty_uart(rtty_t* r, float d, size_t n)
+{
+    if( r->state == RTTY_IDLE )
+    {
+        if( r->prev > 0 && d <= 0 )
+        {
+            r->state = RTTY_BITS;
+            r->bit = 0;
+            r->c = 0;
+            r->next = n + r->bit_len / 2;
+            r->char_at = n - r->bit_len / 2;
+        }
+    }
+    else if( n >= r->next )
+    {
+        bool mark = d > 0;
+
+        if( r->bit == 0 )
+        {
+            // Glitch rather than a start bit
+            if( mark ) r->state = RTTY_IDLE;
+        }
+        else if( r->bit <= RTTY_DATA_BITS )
+        {
+            if( mark ) r->c |= 1 << (r->bit - 1);
+        }
+        else
+        {
+            if( mark ) _rtty_char(r, r->c);
+            r->state = RTTY_IDLE;
+        }
+        r->bit++;
+        r->next += r->bit_len;
+    }
+    r->prev = d;
+}
+
+/**
+ * Decode every sentence starting between start and end, reading as far
+ * either side as rtty_margin() says. cb is called for each in order.
+ */
+void rtty_decode(source_t* src, rtty_config_t* cfg, size_t start,
+        size_t end, rtty_sentence_cb cb, void* param)
+{
+    rtty_t r;
+    size_t margin = rtty_margin(src, cfg);
+    size_t from = start > margin ? start - margin : 0;
+    size_t to = end + margin < src->samples ? end + margin : src->samples;
+
+    memset(&r, 0, sizeof(r));
+    r.bit_len = src->rate / cfg->baud + 0.5;
+    r.omega[0] = 2 * M_PI * cfg->mark / src->rate;
+    r.omega[1] = 2 * M_PI * cfg->space / src->rate;
+    r.hist = _rtty_alloc(r.bit_len * sizeof(v4d));
+    r.keep_from = start;
+    r.keep_to = end;
+    r.cb = cb;
+    r.param = param;
+
+    float* re = _rtty_alloc(RTTY_BLOCK * sizeof(float));
+    float* im = _rtty_alloc(RTTY_BLOCK * sizeof(float));
+    float (*mix)[RTTY_BLOCK] = _rtty_alloc(4 * RTTY_BLOCK * sizeof(float));
+
+    for(size_t n0 = from; n0 < to; n0 += RTTY_BLOCK)
+    {
+        size_t count = to - n0 < RTTY_BLOCK ? to - n0 : RTTY_BLOCK;
+
+        source_read(src, n0, RTTY_BLOCK, re, im);
+        _rtty_mix(&r, n0, re, im, mix);
+
+        for(size_t i = 0; i < count; i++)
+        {
+            v4d x = {mix[0][i], mix[1][i], mix[2][i], mix[3][i]};
+            r.acc += x - r.hist[r.hist_ptr];
+            r.hist[r.hist_ptr] = x;
+            if( ++r.hist_ptr == r.bit_len ) r.hist_ptr = 0;
+
+            float d = r.acc[0] * r.acc[0] + r.acc[1] * r.acc[1] -
+                r.acc[2] * r.acc[2] - r.acc[3] * r.acc[3];
+            _rtty_uart(&r, d, n0 + i);
+        }
+    }
+
+    free(mix);
+    free(im);
+    free(re);
+    free(r.hist);
+}
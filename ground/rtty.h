@@ -0,0 +1,50 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __RTTY_H__
+#define __RTTY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "source.h"
+
+// Longest sentence we collect, including the checksum trailer
+#define RTTY_MAX_SENTENCE   200
+
+// Samples run through the mixers at a time, a multiple of 8
+#define RTTY_BLOCK          4096
+
+/**
+ * What to listen for. Frequencies are in Hz in the recording, so for
+ * IQ they may be negative.
+ */
+typedef struct
+{
+    float mark;
+    float space;
+    float baud;
+} rtty_config_t;
+
+/**
+ * A sentence as it came off the air
+ */
+typedef struct
+{
+    size_t at;              // sample the first $ started on
+    bool crc_ok;
+    uint16_t len;
+    char text[RTTY_MAX_SENTENCE + 1];
+} rtty_sentence_t;
+
+typedef void (*rtty_sentence_cb)(rtty_sentence_t* s, void* param);
+
+void rtty_decode(source_t* src, rtty_config_t* cfg, size_t start,
+        size_t end, rtty_sentence_cb cb, void* param);
+size_t rtty_margin(source_t* src, rtty_config_t* cfg);
+
+#endif /* __RTTY_H__ */
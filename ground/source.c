@@ -0,0 +1,164 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+
+static uint32_t _source_le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t _source_le16(const uint8_t* p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/**
+ * Find the format and data chunks of a WAV file.
+ */
+static int _source_wav(source_t* src, bool iq)
+{
+    const uint8_t* p = src->map + 12;
+    const uint8_t* end = src->map + src->map_len;
+    uint16_t tag = 0, bits = 0;
+
+    while( p + 8 <= end )
+    {
+        uint32_t len = _source_le32(p + 4);
+        const uint8_t* body = p + 8;
+
+        if( memcmp(p, "fmt ", 4) == 0 && len >= 16 )
+        {
+            tag = _source_le16(body);
+            src->channels = _source_le16(body + 2);
+            src->rate = _source_le32(body + 4);
+            bits = _source_le16(body + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag in the subformat
+            if( tag == 0xFFFE && len >= 26 )
+                tag = _source_le16(body + 24);
+        }
+        else if( memcmp(p, "data", 4) == 0 )
+        {
+            if( len > (size_t)(end - body) ) len = end - body;
+            src->data = body;
+
+            if( tag == 1 && bits == 16 )
+                src->format = SOURCE_S16;
+            else if( tag == 3 && bits == 32 )
+                src->format = SOURCE_F32;
+            else
+                return -1;
+
+            if( !src->channels ) return -1;
+            src->samples = len / (bits / 8) / src->channels;
+            src->iq = iq && src->channels >= 2;
+            return 0;
+        }
+        p = body + len + (len & 1);
+    }
+    return -1;
+}
+
+/**
+ * Map a recording, either a WAV file or raw cf32 at the given rate.
+ * Returns 0 on success.
+ */
+int source_open(source_t* src, const char* path, uint32_t rate, bool iq)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    memset(src, 0, sizeof(*src));
+    if( fd < 0 ) return -1;
+    if( fstat(fd, &st) < 0 || st.st_size == 0 )
+    {
+        close(fd);
+        return -1;
+    }
+
+    src->map_len = st.st_size;
+    src->map = mmap(NULL, src->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( src->map == MAP_FAILED ) return -1;
+    madvise((void*)src->map, src->map_len, MADV_SEQUENTIAL);
+
+    if( src->map_len >= 12 && memcmp(src->map, "RIFF", 4) == 0 &&
+            memcmp(src->map + 8, "WAVE", 4) == 0 )
+        return _source_wav(src, iq);
+
+    src->format = SOURCE_CF32;
+    src->channels = 2;
+    src->iq = true;
+    src->rate = rate;
+    src->data = src->map;
+    src->samples = src->map_len / 8;
+    return 0;
+}
+
+/**
+ * Read float samples already in memory, interleaved if there is more
+ * than one channel. The caller keeps ownership of data.
+ */
+void source_memory(source_t* src, const float* data, size_t samples,
+        uint32_t rate, uint8_t channels, bool iq)
+{
+    memset(src, 0, sizeof(*src));
+    src->data = (const uint8_t*)data;
+    src->samples = samples;
+    src->rate = rate;
+    src->format = SOURCE_F32;
+    src->channels = channels;
+    src->iq = iq && channels >= 2;
+}
+
+/**
+ * Read n samples from start as floats, with the imaginary part zero for
+ * real recordings. Reads past the end give zeros.
+ */
+void source_read(source_t* src, size_t start, size_t n, float* re,
+        float* im)
+{
+    size_t i = 0;
+
+    for( ; i < n && start + i < src->samples; i++ )
+    {
+        size_t at = (start + i) * src->channels;
+        float a, b = 0.0f;
+
+        if( src->format == SOURCE_S16 )
+        {
+            const int16_t* s = (const int16_t*)src->data + at;
+            a = s[0] * (1.0f / 32768.0f);
+            if( src->iq ) b = s[1] * (1.0f / 32768.0f);
+        }
+        else
+        {
+            const float* s = (const float*)src->data + at;
+            a = s[0];
+            if( src->iq ) b = s[1];
+        }
+        re[i] = a;
+        im[i] = b;
+    }
+    for( ; i < n; i++ )
+        re[i] = im[i] = 0.0f;
+}
+
+void source_close(source_t* src)
+{
+    if( src->map && src->map != MAP_FAILED )
+        munmap((void*)src->map, src->map_len);
+    src->map = NULL;
+}
@@ -0,0 +1,44 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __SOURCE_H__
+#define __SOURCE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Sample formats we can read
+#define SOURCE_S16      0       // 16 bit PCM WAV
+#define SOURCE_F32      1       // 32 bit float WAV
+#define SOURCE_CF32     2       // raw interleaved float I/Q
+
+/**
+ * A recording mapped into memory, read as complex samples from any
+ * thread.
+ */
+typedef struct
+{
+    const uint8_t* map;
+    size_t map_len;
+    const uint8_t* data;
+    size_t samples;
+    uint32_t rate;
+    uint8_t format;
+    uint8_t channels;
+    bool iq;                // two channel WAV holds I and Q
+} source_t;
+
+int source_open(source_t* src, const char* path, uint32_t rate, bool iq);
+void source_memory(source_t* src, const float* data, size_t samples,
+        uint32_t rate, uint8_t channels, bool iq);
+void source_read(source_t* src, size_t start, size_t n, float* re,
+        float* im);
+void source_close(source_t* src);
+
+#endif /* __SOURCE_H__ */
@@ -0,0 +1,306 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "turbo.h"
+
+typedef float v8f __attribute__((vector_size(32)));
+typedef int32_t v8i __attribute__((vector_size(32)));
+
+// Far enough below any real metric to never win, and not overflow when
+// branch metrics are added
+#define TURBO_NEVER     -1e30f
+
+/**
+ * The trellis of one coder, with one lane per state. Going forwards each
+ * state s' has two predecessors, going backwards each state s has a
+ * successor for an input of 0 and of 1. Signs are +1 for a 1 bit and -1
+ * for a 0.
+ */
+typedef struct
+{
+    v8i prev[2];
+    v8f prev_u[2];
+    v8f prev_c[2];
+    v8i next[2];
+    v8f next_c[2];
+} turbo_trellis_t;
+
+static turbo_trellis_t _turbo_trellis;
+static int _turbo_trellis_ready = 0;
+
+/**
+ * One step of the coder from state s, s1 s2 s3 with s1 the most recent,
+ * returning the next state and setting the parity bit.
+ */
+static uint8_t _turbo_step(uint8_t s, uint8_t u, uint8_t* c)
+{
+    uint8_t s1 = s >> 2 & 1, s2 = s >> 1 & 1, s3 = s & 1;
+    uint8_t a = u ^ s2 ^ s3;
+    *c = a ^ s1 ^ s3;
+    return a << 2 | s1 << 1 | s2;
+}
+
+static void _turbo_build_trellis(void)
+{
+    turbo_trellis_t* t = &_turbo_trellis;
+    uint8_t seen[TURBO_STATES] = {0};
+
+    for(uint8_t s = 0; s < TURBO_STATES; s++)
+    {
+        for(uint8_t u = 0; u < 2; u++)
+        {
+            uint8_t c, n = _turbo_step(s, u, &c);
+            t->next[u][s] = n;
+            t->next_c[u][s] = c ? 1 : -1;
+
+            uint8_t j = seen[n]++;
+            t->prev[j][n] = s;
+            t->prev_u[j][n] = u ? 1 : -1;
+            t->prev_c[j][n] = c ? 1 : -1;
+        }
+    }
+    _turbo_trellis_ready = 1;
+}
+
+/**
+ * Set up the code for k input bits with the interleaver
+ * pi(i) = (f1 i + f2 i^2) mod k. Returns 0 on success, or -1 if that is
+ * not a permutation.
+ */
+int turbo_init(turbo_t* turbo, uint16_t k, uint16_t f1, uint16_t f2)
+{
+    uint8_t* used = calloc(k, 1);
+
+    if( !_turbo_trellis_ready ) _turbo_build_trellis();
+
+    turbo->k = k;
+    turbo->pi = malloc(k * sizeof(uint16_t));
+    for(uint32_t i = 0; i < k; i++)
+    {
+        uint32_t p = ((uint64_t)f1 * i + (uint64_t)f2 * i * i) % k;
+        turbo->pi[i] = p;
+        if( used[p]++ )
+        {
+            free(used);
+            turbo_free(turbo);
+            return -1;
+        }
+    }
+    free(used);
+    return 0;
+}
+
+/**
+ * Coded bits for a frame including the tails.
+ */
+uint16_t turbo_coded_bits(turbo_t* turbo)
+{
+    return 3 * turbo->k + 4 * TURBO_TAIL;
+}
+
+static uint8_t _turbo_get(const uint8_t* buf, uint32_t i)
+{
+    return buf[i >> 3] >> (7 - (i & 7)) & 1;
+}
+
+static void _turbo_put(uint8_t* buf, uint32_t i, uint8_t b)
+{
+    if( b ) buf[i >> 3] |= 0x80 >> (i & 7);
+    else buf[i >> 3] &= ~(0x80 >> (i & 7));
+}
+
+/**
+ * Encode k bits from in, MSB first, into turbo_coded_bits() bits at out.
+ * This is what the payload sends, kept here to check against.
+ */
+void turbo_encode(turbo_t* turbo, const uint8_t* in, uint8_t* out)
+{
+    uint32_t k = turbo->k, o = 0;
+    uint8_t s1 = 0, s2 = 0, c1, c2;
+
+    for(uint32_t i = 0; i < k; i++)
+    {
+        uint8_t u = _turbo_get(in, i);
+        s1 = _turbo_step(s1, u, &c1);
+        s2 = _turbo_step(s2, _turbo_get(in, turbo->pi[i]), &c2);
+        _turbo_put(out, o++, u);
+        _turbo_put(out, o++, c1);
+        _turbo_put(out, o++, c2);
+    }
+
+    // Drive each coder back to zero by feeding its feedback back in
+    for(int e = 0; e < 2; e++)
+    {
+        uint8_t* s = e ? &s2 : &s1;
+        for(int i = 0; i < TURBO_TAIL; i++)
+        {
+            uint8_t u = (*s >> 1 ^ *s) & 1, c;
+            *s = _turbo_step(*s, u, &c);
+            _turbo_put(out, o++, u);
+            _turbo_put(out, o++, c);
+        }
+    }
+}
+
+static void* _turbo_alloc(size_t len)
+{
+    void* p = NULL;
+    if( posix_memalign(&p, 32, len) != 0 ) abort();
+    return p;
+}
+
+static inline v8f _turbo_max(v8f a, v8f b)
+{
+    v8i m = a > b;
+    return (v8f)((m & (v8i)a) | (~m & (v8i)b));
+}
+
+static inline float _turbo_hmax(v8f a)
+{
+    float m = a[0];
+    for(int l = 1; l < 8; l++)
+        if( a[l] > m ) m = a[l];
+    return m;
+}
+
+/**
+ * Max-log-MAP over one coder's trellis of n = k + TURBO_TAIL steps, all
+ * eight states a vector at a time. sys and par are the channel values,
+ * apriori the other coder's opinion of the k input bits. Writes the
+ * extrinsic information for each input bit, and the full LLR to llr.
+ */
+static void _turbo_siso(int n, const float* sys, const float* par,
+        const float* apriori, float* extrinsic, float* llr, v8f* alpha)
+{
+    turbo_trellis_t* t = &_turbo_trellis;
+    int k = n - TURBO_TAIL;
+    v8f a = {0, TURBO_NEVER, TURBO_NEVER, TURBO_NEVER,
+        TURBO_NEVER, TURBO_NEVER, TURBO_NEVER, TURBO_NEVER};
+
+    for(int i = 0; i < n; i++)
+    {
+        float lu = 0.5f * (sys[i] + (i < k ? apriori[i] : 0));
+        float lc = 0.5f * par[i];
+
+        alpha[i] = a;
+        v8f a0 = __builtin_shuffle(a, t->prev[0]) + t->prev_u[0] * lu +
+            t->prev_c[0] * lc;
+        v8f a1 = __builtin_shuffle(a, t->prev[1]) + t->prev_u[1] * lu +
+            t->prev_c[1] * lc;
+        a = _turbo_max(a0, a1);
+        a -= a[0];
+    }
+
+    // Both coders are terminated so the end state is zero
+    v8f b = {0, TURBO_NEVER, TURBO_NEVER, TURBO_NEVER,
+        TURBO_NEVER, TURBO_NEVER, TURBO_NEVER, TURBO_NEVER};
+
+    for(int i = n - 1; i >= 0; i--)
+    {
+        float lu = 0.5f * (sys[i] + (i < k ? apriori[i] : 0));
+        float lc = 0.5f * par[i];
+
+        v8f b0 = __builtin_shuffle(b, t->next[0]) - lu + t->next_c[0] * lc;
+        v8f b1 = __builtin_shuffle(b, t->next[1]) + lu + t->next_c[1] * lc;
+
+        if( i < k )
+        {
+            float l = _turbo_hmax(alpha[i] + b1) - _turbo_hmax(alpha[i] + b0);
+            llr[i] = l;
+            extrinsic[i] = TURBO_EXTRINSIC * (l - sys[i] - apriori[i]);
+        }
+
+        b = _turbo_max(b0, b1);
+        b -= b[0];
+    }
+}
+
+/**
+ * Decode turbo_coded_bits() soft bits, positive meaning a 1 and scaled
+ * however the demodulator likes, into k bits at out, MSB first. Safe to
+ * call from many threads at once. Returns the number of iterations
+ * taken, stopping early once both coders agree on every bit.
+ */
+int turbo_decode(turbo_t* turbo, const float* llr, uint8_t* out,
+        int iterations)
+{
+    int k = turbo->k, n = k + TURBO_TAIL, done = 0;
+    const float* tail = llr + 3 * k;
+
+    float* sys1 = _turbo_alloc(n * sizeof(float));
+    float* par1 = _turbo_alloc(n * sizeof(float));
+    float* sys2 = _turbo_alloc(n * sizeof(float));
+    float* par2 = _turbo_alloc(n * sizeof(float));
+    float* e12 = _turbo_alloc(k * sizeof(float));
+    float* e21 = _turbo_alloc(k * sizeof(float));
+    float* ap = _turbo_alloc(k * sizeof(float));
+    float* ex = _turbo_alloc(k * sizeof(float));
+    float* l1 = _turbo_alloc(k * sizeof(float));
+    float* l2 = _turbo_alloc(k * sizeof(float));
+    v8f* alpha = _turbo_alloc(n * sizeof(v8f));
+
+    for(int i = 0; i < k; i++)
+    {
+        sys1[i] = llr[3 * i];
+        par1[i] = llr[3 * i + 1];
+        par2[i] = llr[3 * i + 2];
+    }
+    for(int i = 0; i < k; i++)
+        sys2[i] = sys1[turbo->pi[i]];
+    for(int i = 0; i < TURBO_TAIL; i++)
+    {
+        sys1[k + i] = tail[2 * i];
+        par1[k + i] = tail[2 * i + 1];
+        sys2[k + i] = tail[2 * TURBO_TAIL + 2 * i];
+        par2[k + i] = tail[2 * TURBO_TAIL + 2 * i + 1];
+    }
+    memset(e21, 0, k * sizeof(float));
+
+    while( done < iterations )
+    {
+        done++;
+        _turbo_siso(n, sys1, par1, e21, e12, l1, alpha);
+
+        for(int i = 0; i < k; i++)
+            ap[i] = e12[turbo->pi[i]];
+        _turbo_siso(n, sys2, par2, ap, ex, l2, alpha);
+        for(int i = 0; i < k; i++)
+            e21[turbo->pi[i]] = ex[i];
+
+        int agree = 1;
+        for(int i = 0; i < k && agree; i++)
+            agree = (l1[turbo->pi[i]] > 0) == (l2[i] > 0);
+        if( agree ) break;
+    }
+
+    // The second coder saw the latest of everything
+    memset(out, 0, (k + 7) / 8);
+    for(int i = 0; i < k; i++)
+        if( l2[i] > 0 ) _turbo_put(out, turbo->pi[i], 1);
+
+    free(sys1);
+    free(par1);
+    free(sys2);
+    free(par2);
+    free(e12);
+    free(e21);
+    free(ap);
+    free(ex);
+    free(l1);
+    free(l2);
+    free(alpha);
+    return done;
+}
+
+void turbo_free(turbo_t* turbo)
+{
+    free(turbo->pi);
+    turbo->pi = NULL;
+}
@@ -0,0 +1,48 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __TURBO_H__
+#define __TURBO_H__
+
+#include <stdint.h>
+
+// The binary frame code: two 8 state recursive systematic coders with
+// feedback 13 and parity 15 (octal), the second fed through a quadratic
+// permutation polynomial interleaver, each terminated by three tail bits.
+// Coded bits go out as systematic, parity 1, parity 2 for each input bit
+// then the six tail bits of each coder.
+#define TURBO_STATES        8
+#define TURBO_TAIL          3
+
+// The frame size main.c sends and its interleaver, INT_C_376
+#define TURBO_K_376         376
+#define TURBO_F1_376        45
+#define TURBO_F2_376        94
+
+// Decoder iterations unless told otherwise, and the scaling applied to
+// the extrinsic information to make up for max-log-MAP
+#define TURBO_ITERATIONS    8
+#define TURBO_EXTRINSIC     0.75f
+
+/**
+ * A code of a particular size
+ */
+typedef struct
+{
+    uint16_t k;             // input bits
+    uint16_t* pi;           // interleaved bit i is input bit pi[i]
+} turbo_t;
+
+int turbo_init(turbo_t* turbo, uint16_t k, uint16_t f1, uint16_t f2);
+uint16_t turbo_coded_bits(turbo_t* turbo);
+void turbo_encode(turbo_t* turbo, const uint8_t* in, uint8_t* out);
+int turbo_decode(turbo_t* turbo, const float* llr, uint8_t* out,
+        int iterations);
+void turbo_free(turbo_t* turbo);
+
+#endif /* __TURBO_H__ */
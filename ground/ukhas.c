@@ -0,0 +1,51 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#include "ukhas.h"
+
+/**
+ * CRC-16/XMODEM of everything after the first $ except other $ signs,
+ * the same as radio_calculate_checksum() in the firmware.
+ */
+uint16_t ukhas_crc(const char* s, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    size_t i = 0;
+
+    while( i < len && s[i] != '$' ) i++;
+
+    for( ; i < len; i++ )
+    {
+        if( s[i] == '$' ) continue;
+        crc ^= (uint16_t)(uint8_t)s[i] << 8;
+        for(uint8_t b = 0; b < 8; b++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+/**
+ * Check a sentence ending in *XXXX against its checksum.
+ */
+bool ukhas_verify(const char* sentence, size_t len)
+{
+    uint16_t given = 0;
+
+    if( len < 5 || sentence[len - 5] != '*' ) return false;
+
+    for(size_t i = len - 4; i < len; i++)
+    {
+        char c = sentence[i];
+        given <<= 4;
+        if( c >= '0' && c <= '9' ) given |= c - '0';
+        else if( c >= 'A' && c <= 'F' ) given |= c - 'A' + 10;
+        else if( c >= 'a' && c <= 'f' ) given |= c - 'a' + 10;
+        else return false;
+    }
+    return ukhas_crc(sentence, len - 5) == given;
+}
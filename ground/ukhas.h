@@ -0,0 +1,19 @@
+/**
+ * JOEY-M by CU Spaceflight
+ *
+ * This file is part of the JOEY-M project by Cambridge University Spaceflight.
+ *
+ * Jon Sowman 2012
+ */
+
+#ifndef __UKHAS_H__
+#define __UKHAS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+uint16_t ukhas_crc(const char* s, size_t len);
+bool ukhas_verify(const char* sentence, size_t len);
+
+#endif /* __UKHAS_H__ */